@@ -66,6 +66,14 @@ if [ -d "logs" ]; then
     fi
 fi
 
+# Remove the host's shared parsed dataset (rebuilt on the next scans)
+for DATASET_DIR in "/dev/shm/fire-dataset-$(id -u)" "${TMPDIR:-/tmp}/fire-dataset-$(id -u)"; do
+    if [ -d "${DATASET_DIR}" ]; then
+        echo "  ✓ Removing shared dataset ${DATASET_DIR}"
+        rm -rf "${DATASET_DIR}"
+    fi
+done
+
 # Remove compiled object files
 echo "  ✓ Removing compiled object files"
 find . -type f -name "*.o" -delete 2>/dev/null
@@ -110,6 +118,7 @@ echo "  • Build directory (build/)"
 echo "  • Generated protobuf files (C++ and Python)"
 echo "  • Python cache (__pycache__, *.pyc)"
 echo "  • Log files (logs/*.log)"
+echo "  • Shared parsed dataset (fire-dataset)"
 echo "  • Compiled object files (*.o, *.so, *.dylib)"
 echo "  • CMake cache files"
 echo "  • Temporary files"
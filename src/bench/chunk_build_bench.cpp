@@ -0,0 +1,162 @@
+// Chunk construction benchmark: heap-allocated vs arena-allocated responses.
+//
+// Loads a date range once, then builds and serializes every chunk of the
+// result the way a worker does, once with a fresh heap DelegationResponse per
+// chunk and once with a ChunkArena reset after each chunk. Reports malloc
+// calls (counted through a global operator new) and build time per chunk.
+//
+// Usage: chunk_build_bench [data_path] [chunk_size] [date...]
+//        (defaults: fire-data, 500, every date under data_path)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "fire_query.pb.h"
+#include "common/fire_data_loader.hpp"
+#include "common/record_batch.hpp"
+#include "common/chunk_arena.hpp"
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+
+}  // namespace
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+using firequery::DelegationResponse;
+
+void convertToProto(const FireDataRecord& src, firequery::FireRecord* dest) {
+    dest->set_latitude(src.latitude);
+    dest->set_longitude(src.longitude);
+    dest->set_timestamp(src.timestamp);
+    dest->set_pollutant(src.pollutant);
+    dest->set_concentration(src.concentration);
+    dest->set_unit(src.unit);
+    dest->set_raw_concentration(src.raw_concentration);
+    dest->set_aqi(src.aqi);
+    dest->set_aqi_category(src.aqi_category);
+    dest->set_site_name(src.site_name);
+    dest->set_agency(src.agency);
+    dest->set_site_id(src.site_id);
+    dest->set_full_site_id(src.full_site_id);
+}
+
+// Fill one chunk from records [begin, end), as the worker's send path does
+void fillChunk(DelegationResponse* chunk, firequery::RecordBatch* batch, bool columnar,
+               const std::vector<FireDataRecord>& records, size_t begin, size_t end, int number) {
+    chunk->set_request_id("bench");
+    chunk->set_chunk_number(number);
+    chunk->set_responding_process("bench");
+    int count = static_cast<int>(end - begin);
+    if (columnar) {
+        RecordBatchBuilder builder(batch);
+        builder.reserve(count);
+        for (size_t i = begin; i < end; ++i) builder.add(records[i]);
+        setBatchPayload(*batch, chunk);
+    } else {
+        chunk->mutable_records()->Reserve(count);
+        for (size_t i = begin; i < end; ++i) convertToProto(records[i], chunk->add_records());
+        chunk->set_record_count(count);
+    }
+}
+
+struct Result {
+    size_t chunks = 0;
+    uint64_t allocations = 0;
+    double micros = 0.0;
+    size_t bytes = 0;
+};
+
+Result run(const std::vector<FireDataRecord>& records, size_t chunk_size, bool columnar, bool use_arena) {
+    Result result;
+    std::string wire;
+    wire.reserve(4 * 1024 * 1024);
+    ChunkArena arena;
+
+    uint64_t start_allocs = g_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t begin = 0; begin < records.size(); begin += chunk_size) {
+        size_t end = std::min(records.size(), begin + chunk_size);
+        int number = static_cast<int>(result.chunks);
+        if (use_arena) {
+            DelegationResponse* chunk = arena.create<DelegationResponse>();
+            firequery::RecordBatch* batch = columnar ? arena.create<firequery::RecordBatch>() : nullptr;
+            fillChunk(chunk, batch, columnar, records, begin, end, number);
+            chunk->SerializeToString(&wire);
+            arena.reset();
+        } else {
+            DelegationResponse chunk;
+            firequery::RecordBatch batch;
+            fillChunk(&chunk, &batch, columnar, records, begin, end, number);
+            chunk.SerializeToString(&wire);
+        }
+        result.bytes += wire.size();
+        result.chunks++;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    result.allocations = g_allocations.load() - start_allocs;
+    result.micros = std::chrono::duration<double, std::micro>(elapsed).count();
+    return result;
+}
+
+void report(const char* format, const char* mode, const Result& r) {
+    double chunks = r.chunks ? static_cast<double>(r.chunks) : 1.0;
+    std::cout << std::left << std::setw(10) << format << std::setw(7) << mode << std::right
+              << std::setw(8) << r.chunks
+              << std::setw(14) << std::fixed << std::setprecision(1) << r.allocations / chunks
+              << std::setw(14) << std::setprecision(1) << r.micros / chunks
+              << std::setw(14) << r.bytes << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string data_path = argc > 1 ? argv[1] : "fire-data";
+    size_t chunk_size = argc > 2 ? static_cast<size_t>(std::max(1, std::atoi(argv[2]))) : 500;
+
+    std::vector<std::string> dates;
+    for (int i = 3; i < argc; ++i) dates.push_back(argv[i]);
+    if (dates.empty()) {
+        for (const auto& entry : fs::directory_iterator(data_path)) {
+            if (entry.is_directory()) dates.push_back(entry.path().filename().string());
+        }
+        std::sort(dates.begin(), dates.end());
+    }
+
+    FireDataLoader loader(data_path);
+    std::vector<FireDataRecord> records = loader.loadData(dates);
+    std::cout << "Loaded " << records.size() << " records from " << dates.size()
+              << " dates, chunk_size=" << chunk_size << std::endl;
+
+    // Warm up allocator and code paths before measuring
+    run(records, chunk_size, false, false);
+    run(records, chunk_size, true, false);
+
+    std::cout << std::left << std::setw(10) << "format" << std::setw(7) << "alloc" << std::right
+              << std::setw(8) << "chunks" << std::setw(14) << "mallocs/chunk"
+              << std::setw(14) << "us/chunk" << std::setw(14) << "wire_bytes" << std::endl;
+    for (bool columnar : {false, true}) {
+        const char* format = columnar ? "columnar" : "rows";
+        report(format, "heap", run(records, chunk_size, columnar, false));
+        report(format, "arena", run(records, chunk_size, columnar, true));
+    }
+    return 0;
+}
@@ -3,6 +3,12 @@
 #include <string>
 #include <chrono>
 #include <iomanip>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <map>
+#include <unistd.h>
 
 #include <grpc/grpc.h>
 #include <grpcpp/create_channel.h>
@@ -10,6 +16,7 @@
 #include <grpcpp/client_context.h>
 
 #include "fire_query.grpc.pb.h"
+#include "../common/record_batch.hpp"
 
 using grpc::Channel;
 using grpc::ClientContext;
@@ -20,6 +27,12 @@ using firequery::FireQueryService;
 using firequery::QueryRequest;
 using firequery::QueryResponse;
 using firequery::FireRecord;
+using firequery::CancelRequest;
+using firequery::CancelResponse;
+using firequery::DelegationRequest;
+using firequery::DelegationResponse;
+using firequery::RoutingPlan;
+using firequery::RecordFormat;
 
 class FireQueryClient {
 public:
@@ -35,7 +48,13 @@ public:
                   double lon_min = -180.0,
                   double lon_max = 180.0,
                   int max_records = -1,
-                  int chunk_size = 500) {
+                  int chunk_size = 500,
+                  RecordFormat record_format = firequery::COLUMNAR_BATCH,
+                  int target_chunk_bytes = 0,
+                  int cancel_after_ms = -1,
+                  bool direct = false,
+                  const std::string& tenant = "",
+                  int priority = 0) {
 
         QueryRequest request;
         request.set_request_id(request_id);
@@ -48,6 +67,11 @@ public:
         request.set_longitude_max(lon_max);
         request.set_max_records(max_records);
         request.set_chunk_size(chunk_size);
+        request.set_record_format(record_format);
+        request.set_target_chunk_bytes(target_chunk_bytes);
+        request.set_delivery_mode(direct ? firequery::DIRECT : firequery::RELAY);
+        request.set_tenant(tenant);
+        request.set_priority(priority);
 
         std::cout << "\n========================================" << std::endl;
         std::cout << "FIRE QUERY REQUEST" << std::endl;
@@ -58,7 +82,11 @@ public:
         std::cout << "Latitude:      " << lat_min << " to " << lat_max << std::endl;
         std::cout << "Longitude:     " << lon_min << " to " << lon_max << std::endl;
         std::cout << "Max Records:   " << (max_records < 0 ? "UNLIMITED" : std::to_string(max_records)) << std::endl;
-        std::cout << "Chunk Size:    " << chunk_size << std::endl;
+        std::cout << "Chunk Size:    " << chunk_size
+                  << (target_chunk_bytes > 0 ? " (adaptive, target " + std::to_string(target_chunk_bytes) + " bytes)" : "")
+                  << std::endl;
+        std::cout << "Format:        " << (record_format == firequery::COLUMNAR_BATCH ? "columnar" : "rows") << std::endl;
+        std::cout << "Delivery:      " << (direct ? "direct (routing plan)" : "relay via leader") << std::endl;
         std::cout << "========================================\n" << std::endl;
 
         ClientContext context;
@@ -67,15 +95,48 @@ public:
 
         auto start_time = std::chrono::high_resolution_clock::now();
 
+        // Optionally abandon the query with CancelQuery part-way through
+        std::mutex cancel_mutex;
+        std::condition_variable cancel_cv;
+        bool query_done = false;
+        std::thread canceller;
+        if (cancel_after_ms >= 0) {
+            canceller = std::thread([&]() {
+                std::unique_lock<std::mutex> lock(cancel_mutex);
+                if (cancel_cv.wait_for(lock, std::chrono::milliseconds(cancel_after_ms),
+                                       [&]() { return query_done; })) {
+                    return;
+                }
+                lock.unlock();
+                sendCancel(request_id);
+            });
+        }
+
         int chunks_received = 0;
         int total_records = 0;
+        long long total_bytes = 0;
         std::map<std::string, int> records_by_process;
 
+        RoutingPlan plan;
+        bool plan_received = false;
+
         QueryResponse response;
         while (reader->Read(&response)) {
+            if (response.has_routing_plan()) {
+                plan = response.routing_plan();
+                plan_received = true;
+                std::cout << "Routing plan:  " << plan.routes_size() << " routes" << std::endl;
+                for (const auto& route : plan.routes()) {
+                    std::cout << "  " << route.process_id() << " @ " << route.address()
+                              << ": " << route.dates_size() << " dates" << std::endl;
+                }
+                continue;
+            }
+
             chunks_received++;
-            int chunk_records = response.records_size();
+            int chunk_records = chunkRecordCount(response);
             total_records += chunk_records;
+            total_bytes += static_cast<long long>(response.ByteSizeLong());
 
             records_by_process[response.source_process()] += chunk_records;
 
@@ -93,8 +154,18 @@ public:
             if (chunks_received == 1 && chunk_records > 0) {
                 std::cout << "\n--- Sample Records from Chunk 0 ---" << std::endl;
                 int samples = std::min(3, chunk_records);
+                bool columnar = !response.batch_payload().empty();
+                firequery::RecordBatch batch;
+                if (columnar && !batch.ParseFromString(response.batch_payload())) {
+                    std::cerr << "Failed to decode record batch" << std::endl;
+                    samples = 0;
+                }
+                FireRecord expanded;
                 for (int i = 0; i < samples; i++) {
-                    const FireRecord& rec = response.records(i);
+                    if (columnar) {
+                        batchRecordToProto(batch, i, &expanded);
+                    }
+                    const FireRecord& rec = columnar ? expanded : response.records(i);
                     std::cout << "  [" << i << "] "
                               << rec.pollutant() << " "
                               << rec.concentration() << " " << rec.unit()
@@ -113,6 +184,19 @@ public:
 
         Status status = reader->Finish();
 
+        if (status.ok() && plan_received) {
+            status = fetchDirect(request, plan, chunks_received, total_records, total_bytes, records_by_process);
+        }
+
+        if (canceller.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(cancel_mutex);
+                query_done = true;
+            }
+            cancel_cv.notify_one();
+            canceller.join();
+        }
+
         auto end_time = std::chrono::high_resolution_clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
 
@@ -127,6 +211,7 @@ public:
         } else {
             std::cout << "Total Chunks:  " << chunks_received << std::endl;
             std::cout << "Total Records: " << total_records << std::endl;
+            std::cout << "Payload Bytes: " << total_bytes << std::endl;
             std::cout << "Duration:      " << duration.count() << " ms" << std::endl;
             std::cout << "Throughput:    " << (duration.count() > 0 ? (total_records * 1000 / duration.count()) : 0)
                       << " records/sec" << std::endl;
@@ -141,6 +226,66 @@ public:
 
 private:
     std::unique_ptr<FireQueryService::Stub> stub_;
+
+    // Fetch every route of a routing plan in parallel, straight from the owning processes
+    Status fetchDirect(const QueryRequest& query, const RoutingPlan& plan,
+                       int& chunks_received, int& total_records, long long& total_bytes,
+                       std::map<std::string, int>& records_by_process) {
+        std::string serialized_query;
+        query.SerializeToString(&serialized_query);
+
+        std::mutex mutex;
+        Status first_error;
+        std::vector<std::thread> fetchers;
+
+        for (const auto& route : plan.routes()) {
+            fetchers.emplace_back([&, route]() {
+                auto stub = FireQueryService::NewStub(
+                    grpc::CreateChannel(route.address(), grpc::InsecureChannelCredentials()));
+
+                DelegationRequest request;
+                request.set_request_id(query.request_id());
+                request.set_original_query(serialized_query);
+                request.set_delegating_process("client");
+                request.set_local_only(true);
+                for (const auto& date : route.dates()) request.add_target_dates(date);
+
+                ClientContext context;
+                std::unique_ptr<ClientReader<DelegationResponse>> reader(
+                    stub->DelegateQuery(&context, request));
+
+                DelegationResponse chunk;
+                while (reader->Read(&chunk)) {
+                    int chunk_records = chunkRecordCount(chunk);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    chunks_received++;
+                    total_records += chunk_records;
+                    total_bytes += static_cast<long long>(chunk.ByteSizeLong());
+                    records_by_process[chunk.responding_process()] += chunk_records;
+                }
+
+                Status status = reader->Finish();
+                if (!status.ok()) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    std::cerr << "Direct fetch from " << route.process_id() << " failed: "
+                              << status.error_message() << std::endl;
+                    if (first_error.ok()) first_error = status;
+                }
+            });
+        }
+        for (auto& t : fetchers) t.join();
+        return first_error;
+    }
+
+    void sendCancel(const std::string& request_id) {
+        CancelRequest request;
+        request.set_request_id(request_id);
+        CancelResponse response;
+        ClientContext context;
+        Status status = stub_->CancelQuery(&context, request, &response);
+        std::cout << "\nCancelQuery " << request_id << ": "
+                  << (status.ok() ? response.message() : status.error_message()) << std::endl;
+    }
 };
 
 void printUsage(const char* program) {
@@ -151,6 +296,12 @@ void printUsage(const char* program) {
     std::cout << "  --pollutant <type>   Pollutant type (PM2.5, PM10, OZONE), default: all" << std::endl;
     std::cout << "  --max <n>            Maximum records, default: unlimited" << std::endl;
     std::cout << "  --chunk <n>          Chunk size, default: 500" << std::endl;
+    std::cout << "  --format <fmt>       Record encoding (columnar, rows), default: columnar" << std::endl;
+    std::cout << "  --target-bytes <n>   Adaptive chunking toward n bytes per chunk, default: off" << std::endl;
+    std::cout << "  --cancel-after <ms>  Send CancelQuery after ms milliseconds, default: off" << std::endl;
+    std::cout << "  --direct             Fetch data straight from the owning processes (leader sends a routing plan)" << std::endl;
+    std::cout << "  --tenant <name>      Fair-queuing tenant at the leader, default: client address" << std::endl;
+    std::cout << "  --priority <n>       Tenant weight for fair queuing, default: 1" << std::endl;
     std::cout << "\nExamples:" << std::endl;
     std::cout << "  " << program << " localhost:50051" << std::endl;
     std::cout << "  " << program << " localhost:50051 --pollutant PM2.5 --max 5000" << std::endl;
@@ -171,6 +322,12 @@ int main(int argc, char** argv) {
     std::string pollutant = "";
     int max_records = -1;
     int chunk_size = 500;
+    RecordFormat record_format = firequery::COLUMNAR_BATCH;
+    int target_chunk_bytes = 0;
+    int cancel_after_ms = -1;
+    bool direct = false;
+    std::string tenant;
+    int priority = 0;
 
     for (int i = 2; i < argc; i++) {
         std::string arg = argv[i];
@@ -185,6 +342,26 @@ int main(int argc, char** argv) {
             max_records = std::stoi(argv[++i]);
         } else if (arg == "--chunk" && i + 1 < argc) {
             chunk_size = std::stoi(argv[++i]);
+        } else if (arg == "--target-bytes" && i + 1 < argc) {
+            target_chunk_bytes = std::stoi(argv[++i]);
+        } else if (arg == "--direct") {
+            direct = true;
+        } else if (arg == "--tenant" && i + 1 < argc) {
+            tenant = argv[++i];
+        } else if (arg == "--priority" && i + 1 < argc) {
+            priority = std::stoi(argv[++i]);
+        } else if (arg == "--cancel-after" && i + 1 < argc) {
+            cancel_after_ms = std::stoi(argv[++i]);
+        } else if (arg == "--format" && i + 1 < argc) {
+            std::string fmt = argv[++i];
+            if (fmt == "rows") {
+                record_format = firequery::ROW_RECORDS;
+            } else if (fmt == "columnar") {
+                record_format = firequery::COLUMNAR_BATCH;
+            } else {
+                std::cerr << "Unknown format: " << fmt << std::endl;
+                return 1;
+            }
         } else if (arg == "--help" || arg == "-h") {
             printUsage(argv[0]);
             return 0;
@@ -197,12 +374,13 @@ int main(int argc, char** argv) {
         auto channel = grpc::CreateChannel(leader_address, grpc::InsecureChannelCredentials());
         FireQueryClient client(channel);
 
-        // Generate request ID
-        std::string request_id = "req_" + std::to_string(time(nullptr));
+        // Generate request ID (unique across concurrent clients: streams are keyed by it)
+        std::string request_id = "req_" + std::to_string(time(nullptr)) + "_" + std::to_string(getpid());
 
         // Execute query
         client.QueryFire(request_id, date_start, date_end, pollutant,
-                        -90.0, 90.0, -180.0, 180.0, max_records, chunk_size);
+                        -90.0, 90.0, -180.0, 180.0, max_records, chunk_size, record_format,
+                        target_chunk_bytes, cancel_after_ms, direct, tenant, priority);
 
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,161 @@
+#ifndef ADMISSION_HPP
+#define ADMISSION_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Admission control with weighted-fair queuing between tenants.
+//
+// At most max_inflight queries run at once (0 = unlimited); the rest wait in
+// a queue of at most max_queued (0 = unlimited) and are rejected beyond that.
+// Queued queries are started in order of their WFQ finish tag: a tenant's
+// queries are spaced by cost / weight in virtual time, so a tenant sending
+// large queries cannot starve another, and within the order small queries
+// (low cost) get through ahead of large ones queued at the same time.
+// interactive_slots more slots are kept for queries costing at most
+// interactive_max_cost, so those never wait for a long export to finish.
+class AdmissionScheduler {
+public:
+    struct Admission {
+        std::chrono::milliseconds queued;  // time spent waiting
+        bool interactive;                  // holds an interactive slot; pass to finished()
+    };
+    using StartFn = std::function<void(const Admission&)>;
+
+    enum class Decision { kStarted, kQueued, kRejected };
+
+    AdmissionScheduler(int max_inflight, int max_queued, int interactive_slots, double interactive_max_cost)
+        : max_inflight_(max_inflight), max_queued_(max_queued),
+          interactive_slots_(interactive_slots), interactive_max_cost_(interactive_max_cost) {}
+
+    AdmissionScheduler(const AdmissionScheduler&) = delete;
+    AdmissionScheduler& operator=(const AdmissionScheduler&) = delete;
+
+    // Start now (start runs on the caller's thread), queue, or reject
+    Decision submit(uint64_t id, const std::string& tenant, int weight, double cost, StartFn start) {
+        bool interactive = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (isInteractive(cost) && interactive_inflight_ < interactive_slots_) {
+                interactive_inflight_++;
+                interactive = true;
+            } else if (max_inflight_ <= 0 || (inflight_ < max_inflight_ && queue_.empty())) {
+                inflight_++;
+            } else if (max_queued_ > 0 && static_cast<int>(queue_.size()) >= max_queued_) {
+                return Decision::kRejected;
+            } else {
+                double start_tag = std::max(virtual_time_, tenant_finish_[tenant]);
+                double finish_tag = start_tag + std::max(cost, 1.0) / std::max(weight, 1);
+                tenant_finish_[tenant] = finish_tag;
+                queue_.push_back(Entry{id, cost, finish_tag, arrivals_++, std::chrono::steady_clock::now(), std::move(start)});
+                return Decision::kQueued;
+            }
+        }
+        start(Admission{std::chrono::milliseconds(0), interactive});
+        return Decision::kStarted;
+    }
+
+    // Drop a query that is still queued. Returns false if it already started.
+    bool cancel(uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(queue_.begin(), queue_.end(), [id](const Entry& e) { return e.id == id; });
+        if (it == queue_.end()) return false;
+        queue_.erase(it);
+        return true;
+    }
+
+    // A started query is done: start the next queued ones
+    void finished(bool interactive) {
+        std::vector<std::pair<StartFn, Admission>> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            (interactive ? interactive_inflight_ : inflight_)--;
+            while (max_inflight_ <= 0 || inflight_ < max_inflight_) {
+                auto next = nextLocked(false);
+                if (next == queue_.end()) break;
+                inflight_++;
+                ready.push_back(dequeueLocked(next, false));
+            }
+            while (interactive_inflight_ < interactive_slots_) {
+                auto next = nextLocked(true);
+                if (next == queue_.end()) break;
+                interactive_inflight_++;
+                ready.push_back(dequeueLocked(next, true));
+            }
+            pruneTenantsLocked();
+        }
+        for (auto& [start, admission] : ready) start(admission);
+    }
+
+    int inflight() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return inflight_;
+    }
+
+    int queued() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return static_cast<int>(queue_.size());
+    }
+
+private:
+    struct Entry {
+        uint64_t id;
+        double cost;
+        double finish_tag;
+        uint64_t arrival;
+        std::chrono::steady_clock::time_point enqueued;
+        StartFn start;
+    };
+
+    const int max_inflight_;
+    const int max_queued_;
+    const int interactive_slots_;
+    const double interactive_max_cost_;
+    std::mutex mutex_;
+    int inflight_ = 0;
+    int interactive_inflight_ = 0;
+    std::vector<Entry> queue_;
+    std::map<std::string, double> tenant_finish_;
+    double virtual_time_ = 0.0;
+    uint64_t arrivals_ = 0;
+
+    bool isInteractive(double cost) const { return interactive_slots_ > 0 && cost <= interactive_max_cost_; }
+
+    // Queued entry with the smallest finish tag (only interactive-sized ones if asked)
+    std::vector<Entry>::iterator nextLocked(bool interactive_only) {
+        auto best = queue_.end();
+        for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+            if (interactive_only && !isInteractive(it->cost)) continue;
+            if (best == queue_.end() || it->finish_tag < best->finish_tag ||
+                (it->finish_tag == best->finish_tag && it->arrival < best->arrival)) {
+                best = it;
+            }
+        }
+        return best;
+    }
+
+    std::pair<StartFn, Admission> dequeueLocked(std::vector<Entry>::iterator it, bool interactive) {
+        virtual_time_ = std::max(virtual_time_, it->finish_tag);
+        auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - it->enqueued);
+        std::pair<StartFn, Admission> ready{std::move(it->start), Admission{waited, interactive}};
+        queue_.erase(it);
+        return ready;
+    }
+
+    // Tenants whose last finish tag has passed carry no state worth keeping
+    void pruneTenantsLocked() {
+        for (auto it = tenant_finish_.begin(); it != tenant_finish_.end();) {
+            it = it->second <= virtual_time_ ? tenant_finish_.erase(it) : std::next(it);
+        }
+    }
+};
+
+#endif // ADMISSION_HPP
@@ -0,0 +1,101 @@
+#ifndef CANCELLATION_HPP
+#define CANCELLATION_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Cancellation flag shared by everything working on one in-flight request.
+// Copies share the flag. An optional probe adds a second source (typically
+// ServerContext::IsCancelled) that is folded into the flag the first time it fires.
+class CancellationToken {
+public:
+    CancellationToken() : flag_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const { flag_->store(true, std::memory_order_relaxed); }
+
+    void watch(std::function<bool()> probe) { probe_ = std::move(probe); }
+
+    bool cancelled() const {
+        if (flag_->load(std::memory_order_relaxed)) return true;
+        if (probe_ && probe_()) {
+            cancel();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag_;
+    std::function<bool()> probe_;
+};
+
+// Per-process table of in-flight requests, so CancelQuery can reach the
+// streams working on a request id. Several streams may share an id (e.g. a
+// team leader serving the same query for two delegations).
+class CancellationRegistry {
+public:
+    static CancellationRegistry& instance() {
+        static CancellationRegistry registry;
+        return registry;
+    }
+
+    // on_cancel runs under the registry lock and must not block or re-enter the registry
+    uint64_t add(const std::string& request_id, const CancellationToken& token,
+                 std::function<void()> on_cancel = {}) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t handle = next_handle_++;
+        entries_.emplace(handle, Entry{request_id, token, std::move(on_cancel)});
+        return handle;
+    }
+
+    void remove(uint64_t handle) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.erase(handle);
+    }
+
+    // Cancel every in-flight stream of request_id; returns how many were found
+    int cancel(const std::string& request_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int found = 0;
+        for (auto& [handle, entry] : entries_) {
+            if (entry.request_id != request_id) continue;
+            entry.token.cancel();
+            if (entry.on_cancel) entry.on_cancel();
+            found++;
+        }
+        return found;
+    }
+
+private:
+    struct Entry {
+        std::string request_id;
+        CancellationToken token;
+        std::function<void()> on_cancel;
+    };
+
+    std::mutex mutex_;
+    uint64_t next_handle_ = 1;
+    std::map<uint64_t, Entry> entries_;
+};
+
+// Registers a request for the lifetime of a handler
+class ScopedCancellation {
+public:
+    ScopedCancellation(const std::string& request_id, const CancellationToken& token,
+                       std::function<void()> on_cancel = {})
+        : handle_(CancellationRegistry::instance().add(request_id, token, std::move(on_cancel))) {}
+    ~ScopedCancellation() { CancellationRegistry::instance().remove(handle_); }
+
+    ScopedCancellation(const ScopedCancellation&) = delete;
+    ScopedCancellation& operator=(const ScopedCancellation&) = delete;
+
+private:
+    uint64_t handle_;
+};
+
+#endif // CANCELLATION_HPP
@@ -0,0 +1,96 @@
+#ifndef CHANNEL_POOL_HPP
+#define CHANNEL_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/support/channel_arguments.h>
+
+#include "fire_query.grpc.pb.h"
+
+// Several channels (HTTP/2 connections) to one peer, sized by
+// EdgeConfig.channel_pool_size. Each channel gets distinct channel args and a
+// local subchannel pool so gRPC does not fold them back onto one connection.
+// Streams are assigned to the channel with the fewest active streams.
+class ChannelPool {
+private:
+    struct Slot {
+        std::unique_ptr<firequery::FireQueryService::Stub> stub;
+        std::atomic<int> active{0};
+    };
+
+public:
+    // One stream's claim on a channel; released when the lease is destroyed
+    class Lease {
+    public:
+        Lease() = default;
+        explicit Lease(Slot* slot) : slot_(slot) { slot_->active++; }
+        Lease(Lease&& other) noexcept : slot_(other.slot_) { other.slot_ = nullptr; }
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                release();
+                slot_ = other.slot_;
+                other.slot_ = nullptr;
+            }
+            return *this;
+        }
+        ~Lease() { release(); }
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        firequery::FireQueryService::Stub* stub() const { return slot_ ? slot_->stub.get() : nullptr; }
+
+    private:
+        Slot* slot_ = nullptr;
+
+        void release() {
+            if (slot_) slot_->active--;
+            slot_ = nullptr;
+        }
+    };
+
+    ChannelPool(const std::string& target, int size) {
+        size = std::max(1, size);
+        for (int i = 0; i < size; ++i) {
+            grpc::ChannelArguments args;
+            args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+            args.SetInt("fire.channel_pool_index", i);
+            auto slot = std::make_unique<Slot>();
+            slot->stub = firequery::FireQueryService::NewStub(
+                grpc::CreateCustomChannel(target, grpc::InsecureChannelCredentials(), args));
+            slots_.push_back(std::move(slot));
+        }
+    }
+
+    ChannelPool(const ChannelPool&) = delete;
+    ChannelPool& operator=(const ChannelPool&) = delete;
+
+    // Claim the least-loaded channel for a stream
+    Lease acquire() { return Lease(leastLoaded()); }
+
+    // Least-loaded channel for a short unary call that needs no lease
+    firequery::FireQueryService::Stub* stub() { return leastLoaded()->stub.get(); }
+
+    size_t size() const { return slots_.size(); }
+
+private:
+    std::vector<std::unique_ptr<Slot>> slots_;
+
+    Slot* leastLoaded() {
+        Slot* best = slots_.front().get();
+        for (const auto& slot : slots_) {
+            if (slot->active.load(std::memory_order_relaxed) < best->active.load(std::memory_order_relaxed)) {
+                best = slot.get();
+            }
+        }
+        return best;
+    }
+};
+
+#endif // CHANNEL_POOL_HPP
@@ -0,0 +1,56 @@
+#ifndef CHUNK_ARENA_HPP
+#define CHUNK_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <google/protobuf/arena.h>
+
+// Protobuf arena recycled across the chunks of one response stream.
+// Messages built with create() live until reset(), which is called once the
+// chunk has been written. The first block belongs to the stream and survives
+// reset(); when a chunk overflows it, the block grows to fit, so steady-state
+// chunk building stops calling malloc for submessages and strings.
+class ChunkArena {
+public:
+    static constexpr size_t kInitialBlockBytes = 64 * 1024;
+
+    explicit ChunkArena(size_t initial_block = kInitialBlockBytes)
+        : block_(initial_block) {
+        arena_ = std::make_unique<google::protobuf::Arena>(options());
+    }
+
+    ChunkArena(const ChunkArena&) = delete;
+    ChunkArena& operator=(const ChunkArena&) = delete;
+
+    template <typename Message>
+    Message* create() {
+        return google::protobuf::Arena::CreateMessage<Message>(arena_.get());
+    }
+
+    // Free every message created since the last reset
+    void reset() {
+        size_t used = static_cast<size_t>(arena_->SpaceAllocated());
+        if (used <= block_.size()) {
+            arena_->Reset();
+            return;
+        }
+        arena_.reset();
+        block_.assign(used + used / 2, 0);
+        arena_ = std::make_unique<google::protobuf::Arena>(options());
+    }
+
+private:
+    std::vector<char> block_;
+    std::unique_ptr<google::protobuf::Arena> arena_;
+
+    google::protobuf::ArenaOptions options() {
+        google::protobuf::ArenaOptions opts;
+        opts.initial_block = block_.data();
+        opts.initial_block_size = block_.size();
+        return opts;
+    }
+};
+
+#endif // CHUNK_ARENA_HPP
@@ -0,0 +1,75 @@
+#ifndef CHUNKING_HPP
+#define CHUNKING_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+#include "fire_query.pb.h"
+#include "config.hpp"
+
+// Chunk size for a query: the client's QueryRequest.chunk_size when given,
+// otherwise the process default, always clamped to [min_chunk_size, max_chunk_size].
+inline int resolveChunkSize(int requested, const ChunkConfig& cfg) {
+    int size = requested > 0 ? requested : cfg.default_chunk_size;
+    if (cfg.min_chunk_size > 0) size = std::max(size, cfg.min_chunk_size);
+    if (cfg.max_chunk_size > 0) size = std::min(size, cfg.max_chunk_size);
+    return std::max(size, 1);
+}
+
+// Picks the number of records for each chunk of one response stream.
+//
+// Fixed mode (no byte target) always returns the resolved chunk size.
+// Adaptive mode (QueryRequest.target_chunk_bytes, else chunk_config.target_chunk_bytes)
+// starts from the resolved size, doubles it while writes complete without
+// backpressure and halves it when the consumer stalls us, never exceeding the
+// byte target per message or the configured bounds.
+class ChunkSizer {
+public:
+    static constexpr auto kFastWrite = std::chrono::milliseconds(5);
+    static constexpr auto kSlowWrite = std::chrono::milliseconds(50);
+
+    ChunkSizer(const firequery::QueryRequest& query, const ChunkConfig& cfg)
+        : cfg_(cfg), size_(resolveChunkSize(query.chunk_size(), cfg)) {
+        target_bytes_ = query.target_chunk_bytes() > 0 ? query.target_chunk_bytes()
+                                                       : cfg.target_chunk_bytes;
+    }
+
+    bool adaptive() const { return target_bytes_ > 0; }
+
+    // Records to put in the next chunk
+    int next() const { return size_; }
+
+    // Feed back the encoded size of the chunk just written and how long Write() blocked
+    void record(size_t bytes, int records, std::chrono::nanoseconds write_time) {
+        if (!adaptive() || records <= 0 || bytes == 0) return;
+
+        double per_record = static_cast<double>(bytes) / records;
+        bytes_per_record_ = bytes_per_record_ == 0.0 ? per_record
+                                                     : 0.75 * bytes_per_record_ + 0.25 * per_record;
+        int budget = std::max(1, static_cast<int>(target_bytes_ / bytes_per_record_));
+
+        int size = size_;
+        if (write_time <= kFastWrite) {
+            size = size * 2;
+        } else if (write_time >= kSlowWrite) {
+            size = size / 2;
+        }
+        size = std::min(size, budget);
+        size_ = clamp(size);
+    }
+
+private:
+    ChunkConfig cfg_;
+    int size_;
+    int target_bytes_ = 0;
+    double bytes_per_record_ = 0.0;
+
+    int clamp(int size) const {
+        if (cfg_.min_chunk_size > 0) size = std::max(size, cfg_.min_chunk_size);
+        if (cfg_.max_chunk_size > 0) size = std::min(size, cfg_.max_chunk_size);
+        return std::max(size, 1);
+    }
+};
+
+#endif // CHUNKING_HPP
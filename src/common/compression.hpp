@@ -0,0 +1,194 @@
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+
+#include <zlib.h>
+#include <grpcpp/server_context.h>
+
+#include "fire_query.pb.h"
+#include "metrics.hpp"
+
+// Map the "compression" field of an EdgeConfig to the wire enum
+inline firequery::CompressionPolicy parseCompressionPolicy(const std::string& name) {
+    if (name == "gzip") return firequery::COMPRESSION_GZIP;
+    if (name == "deflate") return firequery::COMPRESSION_DEFLATE;
+    if (name == "adaptive") return firequery::COMPRESSION_ADAPTIVE;
+    return firequery::COMPRESSION_NONE;
+}
+
+inline const char* compressionPolicyName(firequery::CompressionPolicy policy) {
+    switch (policy) {
+        case firequery::COMPRESSION_GZIP: return "gzip";
+        case firequery::COMPRESSION_DEFLATE: return "deflate";
+        case firequery::COMPRESSION_ADAPTIVE: return "adaptive";
+        default: return "none";
+    }
+}
+
+// Measurements for one edge (delegating process -> this process), shared by
+// every stream on that edge so a new stream starts from the last decision.
+struct EdgeCompressionStats {
+    double ratio = 1.0;                 // compressed / raw bytes (EWMA)
+    double compress_ns_per_byte = 0.0;  // CPU cost of compressing (EWMA)
+    double wire_bytes_per_ns = 0.0;     // achieved write bandwidth (EWMA), 0 = unknown
+    bool compressing = true;
+    int samples = 0;
+};
+
+class EdgeCompressionRegistry {
+public:
+    static EdgeCompressionRegistry& instance() {
+        static EdgeCompressionRegistry registry;
+        return registry;
+    }
+
+    EdgeCompressionStats get(const std::string& edge) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_[edge];
+    }
+
+    void put(const std::string& edge, const EdgeCompressionStats& stats) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_[edge] = stats;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, EdgeCompressionStats> stats_;
+};
+
+// Applies a CompressionPolicy to one server-streaming response.
+// The stream-level algorithm (gzip/deflate) is fixed when the first message is
+// sent; per-chunk WriteOptions then decide whether each chunk is compressed.
+// gRPC does not report what it achieved, so every kSampleEvery-th chunk is
+// compressed with zlib here to measure ratio and cost for metrics and for the
+// adaptive decision.
+class StreamCompressor {
+public:
+    static constexpr int kWarmupSamples = 3;
+    static constexpr int kSampleEvery = 16;
+    static constexpr double kAlpha = 0.25;       // EWMA weight of new measurements
+    static constexpr double kMaxUsefulRatio = 0.9;
+
+    StreamCompressor(firequery::CompressionPolicy policy,
+                     grpc::ServerContext* context,
+                     const std::string& edge,
+                     const std::string& request_id)
+        : policy_(policy), edge_(edge), request_id_(request_id) {
+        if (policy_ == firequery::COMPRESSION_NONE) return;
+
+        context->set_compression_algorithm(
+            policy_ == firequery::COMPRESSION_DEFLATE ? GRPC_COMPRESS_DEFLATE : GRPC_COMPRESS_GZIP);
+        stats_ = EdgeCompressionRegistry::instance().get(edge_);
+        if (policy_ != firequery::COMPRESSION_ADAPTIVE) stats_.compressing = true;
+    }
+
+    // Decide how to send the next message
+    grpc::WriteOptions nextWriteOptions(const google::protobuf::MessageLite& msg, int chunk_number) {
+        grpc::WriteOptions options;
+        last_raw_bytes_ = msg.ByteSizeLong();
+        if (policy_ == firequery::COMPRESSION_NONE) {
+            return options.set_no_compression();
+        }
+
+        if (chunks_ < kWarmupSamples || chunks_ % kSampleEvery == 0) {
+            sample(msg, chunk_number);
+        }
+        chunks_++;
+
+        last_compressed_ = stats_.compressing;
+        if (!last_compressed_) options.set_no_compression();
+        return options;
+    }
+
+    // Report the time writer->Write() took for the message from nextWriteOptions()
+    void recordWrite(std::chrono::nanoseconds elapsed) {
+        if (policy_ != firequery::COMPRESSION_ADAPTIVE || last_raw_bytes_ == 0) return;
+
+        double wire_bytes = static_cast<double>(last_raw_bytes_);
+        double wire_ns = static_cast<double>(elapsed.count());
+        if (last_compressed_) {
+            // Write() compresses inline; subtract the estimated CPU part
+            wire_ns -= wire_bytes * stats_.compress_ns_per_byte;
+            wire_bytes *= stats_.ratio;
+        }
+        if (wire_ns < 1000.0) wire_ns = 1000.0;
+
+        double bw = wire_bytes / wire_ns;
+        stats_.wire_bytes_per_ns = stats_.wire_bytes_per_ns == 0.0
+            ? bw : (1.0 - kAlpha) * stats_.wire_bytes_per_ns + kAlpha * bw;
+    }
+
+private:
+    firequery::CompressionPolicy policy_;
+    std::string edge_;
+    std::string request_id_;
+    EdgeCompressionStats stats_;
+    int chunks_ = 0;
+    size_t last_raw_bytes_ = 0;
+    bool last_compressed_ = false;
+    std::string scratch_;
+    std::vector<Bytef> compressed_;
+
+    void sample(const google::protobuf::MessageLite& msg, int chunk_number) {
+        msg.SerializeToString(&scratch_);
+        if (scratch_.empty()) return;
+
+        uLongf out_len = compressBound(static_cast<uLong>(scratch_.size()));
+        compressed_.resize(out_len);
+
+        auto start = std::chrono::steady_clock::now();
+        int rc = compress2(compressed_.data(), &out_len,
+                           reinterpret_cast<const Bytef*>(scratch_.data()),
+                           static_cast<uLong>(scratch_.size()), Z_DEFAULT_COMPRESSION);
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+        if (rc != Z_OK) return;
+
+        double ratio = static_cast<double>(out_len) / scratch_.size();
+        double ns_per_byte = static_cast<double>(elapsed.count()) / scratch_.size();
+        if (stats_.samples == 0) {
+            stats_.ratio = ratio;
+            stats_.compress_ns_per_byte = ns_per_byte;
+        } else {
+            stats_.ratio = (1.0 - kAlpha) * stats_.ratio + kAlpha * ratio;
+            stats_.compress_ns_per_byte = (1.0 - kAlpha) * stats_.compress_ns_per_byte + kAlpha * ns_per_byte;
+        }
+        stats_.samples++;
+
+        if (policy_ == firequery::COMPRESSION_ADAPTIVE) {
+            stats_.compressing = shouldCompress();
+        }
+        EdgeCompressionRegistry::instance().put(edge_, stats_);
+
+        std::ostringstream extra;
+        extra << std::fixed << std::setprecision(3)
+              << "edge=" << edge_
+              << ",policy=" << compressionPolicyName(policy_)
+              << ",raw_bytes=" << scratch_.size()
+              << ",compressed_bytes=" << out_len
+              << ",ratio=" << ratio
+              << ",compress_us=" << elapsed.count() / 1000.0
+              << ",bw_mbps=" << stats_.wire_bytes_per_ns * 8000.0
+              << ",compressing=" << (stats_.compressing ? 1 : 0);
+        metrics::log_event("COMPRESSION_SAMPLE", request_id_, -1, -1, chunk_number, -1, extra.str());
+    }
+
+    // Compress when the wire time saved per byte exceeds the CPU time spent.
+    // Unknown bandwidth (no writes measured yet) keeps the edge compressing.
+    bool shouldCompress() const {
+        if (stats_.ratio > kMaxUsefulRatio) return false;
+        if (stats_.wire_bytes_per_ns == 0.0) return true;
+        double saved_ns_per_byte = (1.0 - stats_.ratio) / stats_.wire_bytes_per_ns;
+        return stats_.compress_ns_per_byte < saved_ns_per_byte;
+    }
+};
+
+#endif // COMPRESSION_HPP
@@ -8,6 +8,7 @@
 #include <stdexcept>
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
 
 // Simple JSON parser (minimal implementation for this project)
 // In production, would use nlohmann/json or similar
@@ -18,20 +19,60 @@ struct EdgeConfig {
     int port;
     std::string relationship;
     std::string team;
+    std::string compression;  // none (default), gzip, deflate or adaptive
+    int relay_weight;         // chunks relayed from this edge per round-robin turn (default 1)
+    int channel_pool_size;    // connections opened to this peer (default 1)
+    std::string transport;    // chunks from this peer: auto (default: shared memory if on this host), grpc or shm
 };
 
 struct ChunkConfig {
     int default_chunk_size;
     int max_chunk_size;
     int min_chunk_size;
+    int target_chunk_bytes;   // >0 enables adaptive chunking toward this message size
+    int credit_window;        // >0: chunks of credit given to each delegation stream we consume
+};
+
+struct AdmissionConfig {
+    int max_inflight_queries; // >0: queries fanned out at once by the leader, the rest queue
+    int max_queued_queries;   // >0: queued queries beyond which new ones are rejected
+    int interactive_slots;    // extra slots only for queries costing <= interactive_max_cost
+    int interactive_max_cost; // in dates covered
+    int coalesce_replay_chunks; // >0: identical queries join an execution that has sent at most this many chunks
+};
+
+struct HedgeConfig {
+    int percentile;           // >0: hedge a unit after this percentile of recent first-response latency
+    int min_delay_ms;         // floor for the hedge delay, also used until enough latencies are seen
+};
+
+struct PacingConfig {
+    std::string unit;         // "bytes" (default) or "records"
+    int stream_rate;          // >0: units per second per outgoing stream
+    int process_rate;         // >0: units per second across all of this process's streams
+    int burst;                // bucket depth in units (default: one second of the rate)
+};
+
+struct WorkStealingConfig {
+    bool enabled;             // team leader: split queries into hour-file tasks that idle members steal
+    bool shared_storage;      // every team member sees every date's files, not only the ones it holds
+                              // (workers then accept task files of any date)
+};
+
+struct RepartitionConfig {
+    int interval_s;           // >0: leader rebalances date ownership by scan cost this often
+    int max_imbalance_pct;    // busiest process's load as a % of the mean that triggers a rebalance (default 125)
+    int max_moves;            // dates migrated per round (default 2)
 };
 
 struct DataPartitioning {
     std::string strategy;
     std::vector<std::string> owned_dates;
+    std::vector<std::string> replica_dates;  // copies of other processes' dates, served only when targeted
 };
 
 struct ProcessConfig {
+    std::string config_file;  // where this was loaded from, for partition reloads
     std::string process_id;
     std::string role;
     std::string listen_host;
@@ -39,24 +80,26 @@ struct ProcessConfig {
     std::string data_path;
     std::string team;
     bool is_team_leader;
+    int status_slots;         // leader: processes the shared status registry holds (default kDefaultStatusSlots)
+    int load_sample_ms;       // how often CPU and queue load are published to the status registry (default 500)
+    std::string shared_dataset_dir; // parsed data shared by the processes of a host ("" = default location, "none" = off)
     std::vector<EdgeConfig> edges;
     DataPartitioning data_partitioning;
     ChunkConfig chunk_config;
+    HedgeConfig hedge_config;
+    AdmissionConfig admission_config;
+    PacingConfig pacing_config;
+    WorkStealingConfig work_stealing_config;
+    RepartitionConfig repartition_config;
 };
 
 class ConfigParser {
 public:
     static ProcessConfig loadConfig(const std::string& config_file) {
-        std::ifstream file(config_file);
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open config file: " + config_file);
-        }
-
-        std::stringstream buffer;
-        buffer << file.rdbuf();
-        std::string content = buffer.str();
+        std::string content = readFile(config_file);
 
         ProcessConfig config;
+        config.config_file = config_file;
 
         // Simple manual JSON parsing (replace with proper library in production)
         config.process_id = extractString(content, "process_id");
@@ -73,25 +116,82 @@ public:
             config.data_path = extractString(content, "data_path");
         }
 
-        config.team = extractString(content, "\"team\"");
+        config.team = extractString(content, "team");  // the process's own key comes before its edges'
         config.is_team_leader = extractBool(content, "is_team_leader");
+        config.status_slots = extractInt(content, "status_slots");
+        config.load_sample_ms = extractInt(content, "load_sample_ms");
+        if (config.load_sample_ms <= 0) config.load_sample_ms = 500;
+        config.shared_dataset_dir = extractString(content, "shared_dataset_dir");
 
         // Extract edges
         config.edges = extractEdges(content);
 
         // Extract data partitioning
-        config.data_partitioning.strategy = extractString(content, "strategy");
-        config.data_partitioning.owned_dates = extractStringArray(content, "owned_dates");
+        config.data_partitioning = extractPartitioning(content);
 
         // Extract chunk config
         config.chunk_config.default_chunk_size = extractInt(content, "default_chunk_size");
         config.chunk_config.max_chunk_size = extractInt(content, "max_chunk_size");
         config.chunk_config.min_chunk_size = extractInt(content, "min_chunk_size");
+        config.chunk_config.target_chunk_bytes = extractInt(content, "target_chunk_bytes");
+        config.chunk_config.credit_window = extractInt(content, "credit_window");
+
+        // Extract hedging config (optional)
+        config.hedge_config.percentile = extractInt(content, "hedge_percentile");
+        config.hedge_config.min_delay_ms = extractInt(content, "hedge_min_delay_ms");
+
+        // Extract admission control config (leader, optional)
+        config.admission_config.max_inflight_queries = extractInt(content, "max_inflight_queries");
+        config.admission_config.max_queued_queries = extractInt(content, "max_queued_queries");
+        config.admission_config.interactive_slots = extractInt(content, "interactive_slots");
+        config.admission_config.interactive_max_cost = extractInt(content, "interactive_max_cost");
+        config.admission_config.coalesce_replay_chunks = extractInt(content, "coalesce_replay_chunks");
+
+        // Extract stream pacing config (workers and team leaders, optional: unlimited)
+        config.pacing_config.unit = extractString(content, "pacing_unit");
+        config.pacing_config.stream_rate = extractInt(content, "pacing_stream_rate");
+        config.pacing_config.process_rate = extractInt(content, "pacing_process_rate");
+        config.pacing_config.burst = extractInt(content, "pacing_burst");
+
+        // Extract work stealing config (team leader, optional)
+        config.work_stealing_config.enabled = extractBool(content, "work_stealing");
+        config.work_stealing_config.shared_storage = extractBool(content, "shared_storage");
+
+        // Extract repartitioning config (leader, optional)
+        config.repartition_config.interval_s = extractInt(content, "repartition_interval_s");
+        config.repartition_config.max_imbalance_pct = extractInt(content, "repartition_max_imbalance_pct");
+        if (config.repartition_config.max_imbalance_pct <= 100) config.repartition_config.max_imbalance_pct = 125;
+        config.repartition_config.max_moves = extractInt(content, "repartition_max_moves");
+        if (config.repartition_config.max_moves <= 0) config.repartition_config.max_moves = 2;
 
         return config;
     }
 
+    // Re-read only the data partitioning of a config file (hot reload)
+    static DataPartitioning loadPartitioning(const std::string& config_file) {
+        return extractPartitioning(readFile(config_file));
+    }
+
 private:
+    static std::string readFile(const std::string& config_file) {
+        std::ifstream file(config_file);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open config file: " + config_file);
+        }
+
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    }
+
+    static DataPartitioning extractPartitioning(const std::string& json) {
+        DataPartitioning partitioning;
+        partitioning.strategy = extractString(json, "strategy");
+        partitioning.owned_dates = extractStringArray(json, "owned_dates");
+        partitioning.replica_dates = extractStringArray(json, "replica_dates");
+        return partitioning;
+    }
+
     static std::string extractString(const std::string& json, const std::string& key) {
         std::string search = "\"" + key + "\":";
         size_t pos = json.find(search);
@@ -189,6 +289,12 @@ private:
             edge.port = extractInt(edgeJson, "port");
             edge.relationship = extractString(edgeJson, "relationship");
             edge.team = extractString(edgeJson, "team");
+            edge.compression = extractString(edgeJson, "compression");
+            if (edge.compression.empty()) edge.compression = "none";
+            edge.relay_weight = std::max(1, extractInt(edgeJson, "relay_weight"));
+            edge.channel_pool_size = std::max(1, extractInt(edgeJson, "channel_pool_size"));
+            edge.transport = extractString(edgeJson, "transport");
+            if (edge.transport.empty()) edge.transport = "auto";
 
             edges.push_back(edge);
             pos = objEnd + 1;
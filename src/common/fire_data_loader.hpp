@@ -8,68 +8,165 @@
 #include <iostream>
 #include <filesystem>
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <chrono>
 
-namespace fs = std::filesystem;
+#include "cancellation.hpp"
+#include "fire_record.hpp"
+#include "scan_costs.hpp"
+#include "../shmem/shared_dataset.hpp"
 
-// Fire record structure matching our protobuf (but for internal use)
-struct FireDataRecord {
-    double latitude;
-    double longitude;
-    std::string timestamp;
-    std::string pollutant;
-    double concentration;
-    std::string unit;
-    double raw_concentration;
-    int aqi;
-    int aqi_category;
-    std::string site_name;
-    std::string agency;
-    std::string site_id;
-    std::string full_site_id;
-};
+namespace fs = std::filesystem;
 
 class FireDataLoader {
 public:
-    FireDataLoader(const std::string& data_path) : data_path_(data_path) {
+    // shared_dataset_dir: where parsed files are shared with the other processes
+    // of this host ("" = default location, "none" = parse CSV in every scan)
+    FireDataLoader(const std::string& data_path, const std::string& shared_dataset_dir = "none")
+        : data_path_(data_path), dataset_(shared_dataset_dir) {
         if (!fs::exists(data_path_)) {
             throw std::runtime_error("Data path does not exist: " + data_path_);
         }
     }
 
-    // Load fire data for specific dates and optional filters
-    std::vector<FireDataRecord> loadData(
+    // Lines parsed between cancellation checks
+    static constexpr int kCancelCheckLines = 1024;
+
+    // Receives each matching record of a scan; returning false stops the scan
+    using RecordSink = std::function<bool(FireDataRecord&&)>;
+
+    // Stream fire data for specific dates and optional filters into sink,
+    // one record at a time, so callers can chunk and send while scanning.
+    // A cancelled token stops the scan between files and line batches.
+    // Returns the number of records delivered.
+    size_t scanData(
         const std::vector<std::string>& dates,
-        const std::string& pollutant_filter = "",
-        double lat_min = -90.0, double lat_max = 90.0,
-        double lon_min = -180.0, double lon_max = 180.0,
-        int max_records = -1) {
+        const std::string& pollutant_filter,
+        double lat_min, double lat_max,
+        double lon_min, double lon_max,
+        int max_records,
+        const CancellationToken* cancel,
+        const RecordSink& sink) {
 
-        std::vector<FireDataRecord> results;
+        ScanState state{pollutant_filter, lat_min, lat_max, lon_min, lon_max, max_records, cancel, sink};
 
+        // Scan all CSV files of these dates
+        std::vector<std::string> paths;
         for (const auto& date : dates) {
             std::string date_dir = data_path_ + "/" + date;
             if (!fs::exists(date_dir)) {
                 std::cerr << "Warning: Date directory not found: " << date_dir << std::endl;
                 continue;
             }
-
-            // Load all CSV files for this date
             for (const auto& entry : fs::directory_iterator(date_dir)) {
-                if (entry.path().extension() == ".csv") {
-                    loadCSV(entry.path().string(), results, pollutant_filter,
-                            lat_min, lat_max, lon_min, lon_max, max_records);
+                if (entry.path().extension() == ".csv") paths.push_back(entry.path().string());
+            }
+        }
+        scanPaths(paths, state);
+
+        return state.delivered;
+    }
+
+    // Like scanData, over individual CSV files (relative to the data path, as
+    // returned by listFiles) instead of whole dates. Names other than a
+    // dataFileDate-valid "<date>/<name>.csv" are skipped.
+    size_t scanFiles(
+        const std::vector<std::string>& files,
+        const std::string& pollutant_filter,
+        double lat_min, double lat_max,
+        double lon_min, double lon_max,
+        int max_records,
+        const CancellationToken* cancel,
+        const RecordSink& sink) {
+
+        ScanState state{pollutant_filter, lat_min, lat_max, lon_min, lon_max, max_records, cancel, sink};
+
+        std::vector<std::string> paths;
+        for (const auto& file : files) {
+            if (dataFileDate(file).empty()) {
+                std::cerr << "Warning: Not a data file name: " << file << std::endl;
+                continue;
+            }
+            std::string path = data_path_ + "/" + file;
+            if (!fs::exists(path)) {
+                std::cerr << "Warning: Data file not found: " << path << std::endl;
+                continue;
+            }
+            paths.push_back(std::move(path));
+        }
+        scanPaths(paths, state);
+
+        return state.delivered;
+    }
+
+    // Date of a file named relative to the data path, or "" unless the name
+    // is "<date>/<name>.csv" and resolves (symlinks included) to a file
+    // inside the data path
+    std::string dataFileDate(const std::string& file) const {
+        fs::path relative(file);
+        if (relative.is_absolute()) return "";
+        std::vector<std::string> parts;
+        for (const auto& part : relative) parts.push_back(part.string());
+        if (parts.size() != 2 || relative.extension() != ".csv") return "";
+        for (const auto& part : parts) {
+            if (part.empty() || part == "." || part == "..") return "";
+        }
 
-                    if (max_records > 0 && results.size() >= static_cast<size_t>(max_records)) {
-                        results.resize(max_records);
-                        return results;
-                    }
-                }
+        std::error_code ec;
+        fs::path root = fs::weakly_canonical(data_path_, ec);
+        if (ec) return "";
+        fs::path resolved = fs::weakly_canonical(root / relative, ec);
+        if (ec) return "";
+        auto mismatch = std::mismatch(root.begin(), root.end(), resolved.begin(), resolved.end());
+        if (mismatch.first != root.end()) return "";
+        return parts[0];
+    }
+
+    // CSV files of a date relative to the data path, in name (hour) order.
+    // Empty if the date is not stored here.
+    std::vector<std::string> listFiles(const std::string& date) {
+        std::vector<std::string> files;
+        std::string date_dir = data_path_ + "/" + date;
+        std::error_code ec;
+        if (!fs::is_directory(date_dir, ec)) return files;
+        for (const auto& entry : fs::directory_iterator(date_dir, ec)) {
+            if (entry.path().extension() == ".csv") {
+                files.push_back(date + "/" + entry.path().filename().string());
             }
         }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    // Load fire data for specific dates and optional filters into memory.
+    // A cancelled token stops the scan; the records read so far are returned.
+    std::vector<FireDataRecord> loadData(
+        const std::vector<std::string>& dates,
+        const std::string& pollutant_filter = "",
+        double lat_min = -90.0, double lat_max = 90.0,
+        double lon_min = -180.0, double lon_max = 180.0,
+        int max_records = -1,
+        const CancellationToken* cancel = nullptr) {
 
+        std::vector<FireDataRecord> results;
+        scanData(dates, pollutant_filter, lat_min, lat_max, lon_min, lon_max, max_records, cancel,
+                 [&results](FireDataRecord&& record) {
+                     results.push_back(std::move(record));
+                     return true;
+                 });
         return results;
     }
 
+    // Cost of every file scanned so far, by date
+    ScanCostTable& scanCosts() { return scan_costs_; }
+
+    const SharedDataset& sharedDataset() const { return dataset_; }
+
+    // Bytes of the files the running scans have yet to finish, and how many scans are running
+    int64_t inflightScanBytes() const { return inflight_bytes_.load(std::memory_order_relaxed); }
+    int activeScans() const { return active_scans_.load(std::memory_order_relaxed); }
+
     // Get available dates in the data directory
     std::vector<std::string> getAvailableDates() {
         std::vector<std::string> dates;
@@ -84,13 +181,54 @@ public:
 
 private:
     std::string data_path_;
+    ScanCostTable scan_costs_;
+    SharedDataset dataset_;
+    std::atomic<int64_t> inflight_bytes_{0};
+    std::atomic<int> active_scans_{0};
+
+    struct ScanState {
+        const std::string& pollutant_filter;
+        double lat_min, lat_max;
+        double lon_min, lon_max;
+        int max_records;
+        const CancellationToken* cancel;
+        const RecordSink& sink;
+        size_t delivered = 0;
+        bool stopped = false;
+    };
+
+    // Scan files in order, counting each in the in-flight bytes until it is done
+    void scanPaths(const std::vector<std::string>& paths, ScanState& state) {
+        std::vector<int64_t> sizes;
+        sizes.reserve(paths.size());
+        int64_t total = 0;
+        for (const auto& path : paths) {
+            std::error_code ec;
+            auto size = fs::file_size(path, ec);
+            sizes.push_back(ec ? 0 : static_cast<int64_t>(size));
+            total += sizes.back();
+        }
+        inflight_bytes_ += total;
+        active_scans_++;
+
+        size_t done = 0;
+        for (; done < paths.size(); ++done) {
+            if (state.stopped || (state.cancel && state.cancel->cancelled())) break;
+            scanCSV(paths[done], state);
+            inflight_bytes_ -= sizes[done];
+        }
+        for (size_t left = done; left < paths.size(); ++left) inflight_bytes_ -= sizes[left];
+        active_scans_--;
+    }
 
-    void loadCSV(const std::string& csv_path,
-                 std::vector<FireDataRecord>& results,
-                 const std::string& pollutant_filter,
-                 double lat_min, double lat_max,
-                 double lon_min, double lon_max,
-                 int max_records) {
+    void scanCSV(const std::string& csv_path, ScanState& state) {
+        auto started = std::chrono::steady_clock::now();
+        // A limited scan reads a few lines of the CSV rather than parse all of it
+        auto parse = [this](const std::string& line) { return parseCSVLine(line); };
+        if (auto parsed = dataset_.open(csv_path, parse, state.cancel, state.max_records <= 0)) {
+            scanParsed(*parsed, csv_path, started, state);
+            return;
+        }
 
         std::ifstream file(csv_path);
         if (!file.is_open()) {
@@ -98,33 +236,101 @@ private:
             return;
         }
 
+        // Time handed to the sink (a consumer out of credit) is not scan cost
+        std::chrono::steady_clock::duration in_sink{0};
+        int64_t bytes = 0;
+
         std::string line;
+        int lines = 0;
         while (std::getline(file, line)) {
-            if (max_records > 0 && results.size() >= static_cast<size_t>(max_records)) {
+            lines++;
+            bytes += static_cast<int64_t>(line.size()) + 1;
+            if (state.max_records > 0 && state.delivered >= static_cast<size_t>(state.max_records)) {
+                state.stopped = true;
+                break;
+            }
+            if (state.cancel && lines % kCancelCheckLines == 0 && state.cancel->cancelled()) {
+                state.stopped = true;
                 break;
             }
 
             FireDataRecord record = parseCSVLine(line);
 
             // Apply filters
-            if (!pollutant_filter.empty() && record.pollutant != pollutant_filter) {
+            if (!state.pollutant_filter.empty() && record.pollutant != state.pollutant_filter) {
+                continue;
+            }
+
+            if (record.latitude < state.lat_min || record.latitude > state.lat_max) {
                 continue;
             }
 
-            if (record.latitude < lat_min || record.latitude > lat_max) {
+            if (record.longitude < state.lon_min || record.longitude > state.lon_max) {
                 continue;
             }
 
-            if (record.longitude < lon_min || record.longitude > lon_max) {
+            state.delivered++;
+            auto handed = std::chrono::steady_clock::now();
+            bool more = state.sink(std::move(record));
+            in_sink += std::chrono::steady_clock::now() - handed;
+            if (!more) {
+                state.stopped = true;
+                break;
+            }
+        }
+
+        scan_costs_.record(fs::path(csv_path).parent_path().filename().string(), lines, bytes,
+                           std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - started - in_sink));
+    }
+
+    // Same as scanCSV over the host's parsed copy of the file: rows are
+    // filtered before any string is copied out of the mapping
+    void scanParsed(const DatasetFile& parsed, const std::string& csv_path,
+                    std::chrono::steady_clock::time_point started, ScanState& state) {
+        std::chrono::steady_clock::duration in_sink{0};
+        int64_t lines = 0;
+        for (uint64_t index = 0; index < parsed.rows(); ++index) {
+            lines++;
+            if (state.max_records > 0 && state.delivered >= static_cast<size_t>(state.max_records)) {
+                state.stopped = true;
+                break;
+            }
+            if (state.cancel && lines % kCancelCheckLines == 0 && state.cancel->cancelled()) {
+                state.stopped = true;
+                break;
+            }
+
+            const DatasetRow& row = parsed.row(index);
+            if (!state.pollutant_filter.empty() && parsed.text(row.pollutant) != state.pollutant_filter) {
+                continue;
+            }
+            if (row.latitude < state.lat_min || row.latitude > state.lat_max) {
+                continue;
+            }
+            if (row.longitude < state.lon_min || row.longitude > state.lon_max) {
                 continue;
             }
 
-            results.push_back(record);
+            state.delivered++;
+            auto handed = std::chrono::steady_clock::now();
+            bool more = state.sink(parsed.record(index));
+            in_sink += std::chrono::steady_clock::now() - handed;
+            if (!more) {
+                state.stopped = true;
+                break;
+            }
         }
+
+        int64_t bytes = parsed.rows() == 0 ? 0
+            : static_cast<int64_t>(parsed.sourceBytes() * static_cast<uint64_t>(lines) / parsed.rows());
+        scan_costs_.record(fs::path(csv_path).parent_path().filename().string(), lines, bytes,
+                           std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - started - in_sink));
     }
 
     FireDataRecord parseCSVLine(const std::string& line) {
-        FireDataRecord record;
+        FireDataRecord record{};
         std::vector<std::string> fields;
 
         // Simple CSV parser (handles quoted fields)
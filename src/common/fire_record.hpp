@@ -0,0 +1,23 @@
+#ifndef FIRE_RECORD_HPP
+#define FIRE_RECORD_HPP
+
+#include <string>
+
+// Fire record structure matching our protobuf (but for internal use)
+struct FireDataRecord {
+    double latitude;
+    double longitude;
+    std::string timestamp;
+    std::string pollutant;
+    double concentration;
+    std::string unit;
+    double raw_concentration;
+    int aqi;
+    int aqi_category;
+    std::string site_name;
+    std::string agency;
+    std::string site_id;
+    std::string full_site_id;
+};
+
+#endif // FIRE_RECORD_HPP
@@ -0,0 +1,185 @@
+#ifndef FLOW_CONTROL_HPP
+#define FLOW_CONTROL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <iostream>
+
+#include <grpcpp/client_context.h>
+
+#include "fire_query.grpc.pb.h"
+#include "cancellation.hpp"
+
+// Credit-based flow control for delegation streams.
+//
+// The consumer of a DelegateQuery stream sets DelegationRequest.initial_credit
+// (in chunks) and a credit_stream id of its own, and returns credit for that
+// stream with GrantCredit as it drains what it received.
+// The producer takes one credit per chunk before producing it and pauses its
+// scan while it has none, so every tier holds at most its window in memory.
+// initial_credit = 0 disables credit control for the stream.
+class CreditGate {
+public:
+    // How often a paused producer re-checks cancellation it cannot be notified of
+    static constexpr auto kCancelCheckInterval = std::chrono::milliseconds(20);
+
+    explicit CreditGate(int initial) : credit_(initial) {}
+
+    void grant(int chunks) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            credit_ += chunks;
+        }
+        cv_.notify_all();
+    }
+
+    // Take one credit, waiting while none is available. Returns false if cancelled.
+    bool acquire(const CancellationToken* cancel) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (credit_ <= 0) {
+            if (cancel && cancel->cancelled()) return false;
+            cv_.wait_for(lock, kCancelCheckInterval);
+        }
+        credit_--;
+        return true;
+    }
+
+    int available() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return credit_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    int credit_;
+};
+
+// A new credit_stream id for a stream this process consumes
+inline uint64_t newCreditStream() {
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Producer-side table of credit-controlled streams, keyed by request id, the
+// consumer (the delegating process) and the consumer's credit_stream id, so
+// GrantCredit can find its gate even when streams share a request id.
+class CreditRegistry {
+public:
+    static CreditRegistry& instance() {
+        static CreditRegistry registry;
+        return registry;
+    }
+
+    std::shared_ptr<CreditGate> open(const std::string& request_id, const std::string& consumer,
+                                     uint64_t stream, int initial) {
+        auto gate = std::make_shared<CreditGate>(initial);
+        std::lock_guard<std::mutex> lock(mutex_);
+        gates_[key(request_id, consumer, stream)] = gate;
+        return gate;
+    }
+
+    // Remove gate, unless another stream has since registered under its key
+    void close(const std::string& request_id, const std::string& consumer, uint64_t stream,
+               const std::shared_ptr<CreditGate>& gate) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = gates_.find(key(request_id, consumer, stream));
+        if (it != gates_.end() && it->second == gate) gates_.erase(it);
+    }
+
+    bool grant(const std::string& request_id, const std::string& consumer, uint64_t stream, int chunks) {
+        std::shared_ptr<CreditGate> gate;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = gates_.find(key(request_id, consumer, stream));
+            if (it == gates_.end()) return false;
+            gate = it->second;
+        }
+        gate->grant(chunks);
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<CreditGate>> gates_;
+
+    static std::string key(const std::string& request_id, const std::string& consumer, uint64_t stream) {
+        return request_id + "/" + consumer + "/" + std::to_string(stream);
+    }
+};
+
+// Producer side of one stream: no-op when the consumer did not ask for credit
+class StreamCredit {
+public:
+    StreamCredit(const std::string& request_id, const std::string& consumer, uint64_t stream, int initial)
+        : request_id_(request_id), consumer_(consumer), stream_(stream) {
+        if (initial > 0) gate_ = CreditRegistry::instance().open(request_id_, consumer_, stream_, initial);
+    }
+    ~StreamCredit() {
+        if (gate_) CreditRegistry::instance().close(request_id_, consumer_, stream_, gate_);
+    }
+
+    StreamCredit(const StreamCredit&) = delete;
+    StreamCredit& operator=(const StreamCredit&) = delete;
+
+    bool acquire(const CancellationToken* cancel) { return !gate_ || gate_->acquire(cancel); }
+
+private:
+    std::string request_id_;
+    std::string consumer_;
+    uint64_t stream_;
+    std::shared_ptr<CreditGate> gate_;
+};
+
+// Consumer side of one stream: counts drained chunks and says when to return
+// them to the producer. Credit goes back in batches of half the window.
+class CreditReturner {
+public:
+    explicit CreditReturner(int window) : batch_(window > 1 ? window / 2 : 1) {}
+
+    // Record one drained chunk; returns the credit to grant now (0 = keep batching)
+    int consumed() {
+        if (++owed_ < batch_) return 0;
+        int grant = owed_;
+        owed_ = 0;
+        return grant;
+    }
+
+private:
+    int batch_;
+    int owed_ = 0;
+};
+
+// Return credit to a producer without blocking the caller
+inline void grantCreditAsync(firequery::FireQueryService::Stub* stub,
+                             const std::string& request_id,
+                             const std::string& consumer,
+                             uint64_t stream,
+                             int chunks) {
+    struct GrantCall {
+        grpc::ClientContext context;
+        firequery::CreditGrant request;
+        firequery::CreditAck response;
+    };
+    auto* call = new GrantCall();
+    call->request.set_request_id(request_id);
+    call->request.set_consumer_process(consumer);
+    call->request.set_credit_stream(stream);
+    call->request.set_chunks(chunks);
+    stub->async()->GrantCredit(&call->context, &call->request, &call->response,
+        [call](grpc::Status status) {
+            if (!status.ok()) {
+                std::cerr << "GrantCredit for " << call->request.request_id()
+                          << " failed: " << status.error_message() << std::endl;
+            }
+            delete call;
+        });
+}
+
+#endif // FLOW_CONTROL_HPP
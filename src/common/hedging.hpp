@@ -0,0 +1,111 @@
+#ifndef HEDGING_HPP
+#define HEDGING_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Recent first-response latencies of delegated streams. The hedge delay is a
+// percentile of them, never below the configured floor.
+class LatencyTracker {
+public:
+    static constexpr size_t kCapacity = 256;
+    static constexpr size_t kMinSamples = 8;  // below this the floor is used
+
+    void record(std::chrono::milliseconds latency) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        samples_.push_back(latency.count());
+        if (samples_.size() > kCapacity) samples_.pop_front();
+    }
+
+    std::chrono::milliseconds percentile(int p, std::chrono::milliseconds floor) {
+        std::vector<long long> sorted;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (samples_.size() < kMinSamples) return floor;
+            sorted.assign(samples_.begin(), samples_.end());
+        }
+        size_t rank = std::min(sorted.size() - 1, sorted.size() * static_cast<size_t>(std::clamp(p, 0, 100)) / 100);
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        return std::max(floor, std::chrono::milliseconds(sorted[rank]));
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<long long> samples_;
+};
+
+// First-response race between the copies of one hedged delegation. The first
+// copy to deliver a chunk (or to finish cleanly without one) wins; every other
+// copy is told to stop before any of its chunks are used.
+class HedgeRace {
+public:
+    static constexpr int kNone = -1;
+
+    // Register a copy; on_lose runs once if another copy wins.
+    // Returns kNone (do not start the copy) once the race is decided.
+    int addCopy(std::function<void()> on_lose) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (winner_ != kNone) return kNone;
+        copies_.push_back(Copy{std::move(on_lose), false});
+        return static_cast<int>(copies_.size()) - 1;
+    }
+
+    // Copy `copy` has a response. Returns true if it is the winner.
+    bool claim(int copy) {
+        std::vector<std::function<void()>> losers;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (winner_ != kNone) return winner_ == copy;
+            winner_ = copy;
+            for (int i = 0; i < static_cast<int>(copies_.size()); ++i) {
+                if (i != copy && copies_[i].on_lose) losers.push_back(std::move(copies_[i].on_lose));
+            }
+        }
+        cv_.notify_all();
+        for (auto& lose : losers) lose();
+        return true;
+    }
+
+    // Copy `copy` ended with an error before responding
+    void fail(int copy) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            copies_[copy].failed = true;
+        }
+        cv_.notify_all();
+    }
+
+    // Wait until a copy wins or every copy failed, at most `timeout`.
+    // Returns false on timeout.
+    bool waitFor(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return cv_.wait_for(lock, timeout, [this]() { return winner_ != kNone || allFailedLocked(); });
+    }
+
+    int winner() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return winner_;
+    }
+
+private:
+    struct Copy {
+        std::function<void()> on_lose;
+        bool failed;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<Copy> copies_;
+    int winner_ = kNone;
+
+    bool allFailedLocked() const {
+        return std::all_of(copies_.begin(), copies_.end(), [](const Copy& c) { return c.failed; });
+    }
+};
+
+#endif // HEDGING_HPP
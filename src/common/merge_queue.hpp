@@ -0,0 +1,67 @@
+#ifndef MERGE_QUEUE_HPP
+#define MERGE_QUEUE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Bounded many-producer / one-consumer queue used to merge several response
+// streams into one writer. Producers block while the queue is full, so a slow
+// consumer backpressures every source. pop() returns false once every
+// producer has called producerDone() and the queue is drained, or after close().
+template <typename T>
+class MergeQueue {
+public:
+    explicit MergeQueue(size_t capacity, int producers)
+        : capacity_(capacity), producers_(producers) {}
+
+    MergeQueue(const MergeQueue&) = delete;
+    MergeQueue& operator=(const MergeQueue&) = delete;
+
+    // Blocking push. Returns false if the consumer closed the queue.
+    bool push(T&& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_cv_.wait(lock, [this]() { return closed_ || queue_.size() < capacity_; });
+        if (closed_) return false;
+        queue_.push_back(std::move(item));
+        not_empty_cv_.notify_one();
+        return true;
+    }
+
+    void producerDone() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--producers_ <= 0) not_empty_cv_.notify_all();
+    }
+
+    // Blocking pop. Returns false when all producers are done and nothing is left.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_cv_.wait(lock, [this]() { return closed_ || producers_ <= 0 || !queue_.empty(); });
+        if (closed_ || queue_.empty()) return false;
+        item = std::move(queue_.front());
+        queue_.pop_front();
+        not_full_cv_.notify_one();
+        return true;
+    }
+
+    // Consumer gives up: drop buffered items and release blocked producers
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        queue_.clear();
+        not_full_cv_.notify_all();
+        not_empty_cv_.notify_all();
+    }
+
+private:
+    size_t capacity_;
+    int producers_;
+    bool closed_ = false;
+    std::deque<T> queue_;
+    std::mutex mutex_;
+    std::condition_variable not_full_cv_;
+    std::condition_variable not_empty_cv_;
+};
+
+#endif // MERGE_QUEUE_HPP
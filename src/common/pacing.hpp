@@ -0,0 +1,89 @@
+#ifndef PACING_HPP
+#define PACING_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "config.hpp"
+#include "cancellation.hpp"
+
+// Token bucket refilled at `rate` units per second, holding at most `burst`.
+// A reservation always succeeds and may leave the bucket in debt; the caller
+// waits until the debt is paid off, so a chunk larger than the burst is still
+// sent, just followed by a proportionally longer pause. rate <= 0 = unlimited.
+class TokenBucket {
+public:
+    TokenBucket(double rate, double burst)
+        : rate_(rate), burst_(burst > 0 ? burst : rate), tokens_(burst_),
+          last_(std::chrono::steady_clock::now()) {}
+
+    TokenBucket(const TokenBucket&) = delete;
+    TokenBucket& operator=(const TokenBucket&) = delete;
+
+    bool unlimited() const { return rate_ <= 0; }
+
+    // Take `units` now; returns how long to wait before using them
+    std::chrono::steady_clock::duration reserve(double units) {
+        if (unlimited()) return std::chrono::steady_clock::duration::zero();
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto now = std::chrono::steady_clock::now();
+        tokens_ = std::min(burst_, tokens_ + rate_ * std::chrono::duration<double>(now - last_).count());
+        last_ = now;
+        tokens_ -= units;
+        if (tokens_ >= 0) return std::chrono::steady_clock::duration::zero();
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(-tokens_ / rate_));
+    }
+
+private:
+    const double rate_;
+    const double burst_;
+    std::mutex mutex_;
+    double tokens_;
+    std::chrono::steady_clock::time_point last_;
+};
+
+// Paces one outgoing stream against its own bucket and the process-wide one
+// (PacingConfig). Both default to unlimited, in which case pace() is free.
+class StreamPacer {
+public:
+    // How often a throttled producer re-checks cancellation
+    static constexpr auto kCancelCheckInterval = std::chrono::milliseconds(20);
+
+    StreamPacer(const PacingConfig& config, TokenBucket& process)
+        : by_records_(config.unit == "records"),
+          stream_(config.stream_rate, config.burst), process_(process) {}
+
+    // Wait until a chunk of this size may go. Returns false if cancelled while waiting.
+    bool pace(size_t bytes, int records, const CancellationToken* cancel) {
+        if (stream_.unlimited() && process_.unlimited()) return true;
+        double units = by_records_ ? static_cast<double>(records) : static_cast<double>(bytes);
+        auto wait = std::max(stream_.reserve(units), process_.reserve(units));
+        if (wait <= std::chrono::steady_clock::duration::zero()) return true;
+
+        auto until = std::chrono::steady_clock::now() + wait;
+        throttled_ += wait;
+        throttled_chunks_++;
+        for (auto now = std::chrono::steady_clock::now(); now < until; now = std::chrono::steady_clock::now()) {
+            if (cancel && cancel->cancelled()) return false;
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(until - now, kCancelCheckInterval));
+        }
+        return true;
+    }
+
+    long long throttledMs() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(throttled_).count();
+    }
+    int throttledChunks() const { return throttled_chunks_; }
+
+private:
+    const bool by_records_;
+    TokenBucket stream_;
+    TokenBucket& process_;
+    std::chrono::steady_clock::duration throttled_{0};
+    int throttled_chunks_ = 0;
+};
+
+#endif // PACING_HPP
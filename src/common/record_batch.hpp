@@ -0,0 +1,99 @@
+#ifndef RECORD_BATCH_HPP
+#define RECORD_BATCH_HPP
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "fire_query.pb.h"
+#include "fire_data_loader.hpp"
+
+// Columnar encoding of fire records (firequery::RecordBatch).
+// Numeric columns are appended to packed arrays; string columns are
+// dictionary-coded so repeated values (timestamp, pollutant, unit, agency,
+// site ids) are sent once per batch instead of once per record.
+class RecordBatchBuilder {
+public:
+    explicit RecordBatchBuilder(firequery::RecordBatch* batch) : batch_(batch) {}
+
+    void reserve(int n) {
+        batch_->mutable_latitude()->Reserve(n);
+        batch_->mutable_longitude()->Reserve(n);
+        batch_->mutable_concentration()->Reserve(n);
+        batch_->mutable_raw_concentration()->Reserve(n);
+        batch_->mutable_aqi()->Reserve(n);
+        batch_->mutable_aqi_category()->Reserve(n);
+        batch_->mutable_timestamp_idx()->Reserve(n);
+        batch_->mutable_pollutant_idx()->Reserve(n);
+        batch_->mutable_unit_idx()->Reserve(n);
+        batch_->mutable_site_name_idx()->Reserve(n);
+        batch_->mutable_agency_idx()->Reserve(n);
+        batch_->mutable_site_id_idx()->Reserve(n);
+        batch_->mutable_full_site_id_idx()->Reserve(n);
+    }
+
+    void add(const FireDataRecord& rec) {
+        batch_->add_latitude(rec.latitude);
+        batch_->add_longitude(rec.longitude);
+        batch_->add_concentration(rec.concentration);
+        batch_->add_raw_concentration(rec.raw_concentration);
+        batch_->add_aqi(rec.aqi);
+        batch_->add_aqi_category(rec.aqi_category);
+        batch_->add_timestamp_idx(intern(rec.timestamp));
+        batch_->add_pollutant_idx(intern(rec.pollutant));
+        batch_->add_unit_idx(intern(rec.unit));
+        batch_->add_site_name_idx(intern(rec.site_name));
+        batch_->add_agency_idx(intern(rec.agency));
+        batch_->add_site_id_idx(intern(rec.site_id));
+        batch_->add_full_site_id_idx(intern(rec.full_site_id));
+        batch_->set_num_records(batch_->num_records() + 1);
+    }
+
+private:
+    firequery::RecordBatch* batch_;
+    // Keys view the batch's own dictionary entries, which keep their address
+    std::unordered_map<std::string_view, uint32_t> dictionary_;
+
+    uint32_t intern(const std::string& value) {
+        auto it = dictionary_.find(value);
+        if (it != dictionary_.end()) return it->second;
+
+        uint32_t idx = static_cast<uint32_t>(batch_->dictionary_size());
+        batch_->add_dictionary(value);
+        dictionary_.emplace(batch_->dictionary(static_cast<int>(idx)), idx);
+        return idx;
+    }
+};
+
+// Expand record i of a batch back into a row-oriented FireRecord
+inline void batchRecordToProto(const firequery::RecordBatch& batch, int i, firequery::FireRecord* dest) {
+    dest->set_latitude(batch.latitude(i));
+    dest->set_longitude(batch.longitude(i));
+    dest->set_timestamp(batch.dictionary(batch.timestamp_idx(i)));
+    dest->set_pollutant(batch.dictionary(batch.pollutant_idx(i)));
+    dest->set_concentration(batch.concentration(i));
+    dest->set_unit(batch.dictionary(batch.unit_idx(i)));
+    dest->set_raw_concentration(batch.raw_concentration(i));
+    dest->set_aqi(batch.aqi(i));
+    dest->set_aqi_category(batch.aqi_category(i));
+    dest->set_site_name(batch.dictionary(batch.site_name_idx(i)));
+    dest->set_agency(batch.dictionary(batch.agency_idx(i)));
+    dest->set_site_id(batch.dictionary(batch.site_id_idx(i)));
+    dest->set_full_site_id(batch.dictionary(batch.full_site_id_idx(i)));
+}
+
+// Store a finished batch as the opaque payload of a QueryResponse/DelegationResponse.
+// Relays only look at the envelope (record_count), never at the batch itself.
+template <typename Chunk>
+inline void setBatchPayload(const firequery::RecordBatch& batch, Chunk* chunk) {
+    batch.SerializeToString(chunk->mutable_batch_payload());
+    chunk->set_record_count(batch.num_records());
+}
+
+// Number of records carried by a QueryResponse/DelegationResponse in either format
+template <typename Chunk>
+inline int chunkRecordCount(const Chunk& chunk) {
+    return chunk.batch_payload().empty() ? chunk.records_size() : chunk.record_count();
+}
+
+#endif // RECORD_BATCH_HPP
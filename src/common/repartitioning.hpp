@@ -0,0 +1,254 @@
+#ifndef REPARTITIONING_HPP
+#define REPARTITIONING_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "fire_query.pb.h"
+#include "config.hpp"
+#include "fire_data_loader.hpp"
+#include "scan_costs.hpp"
+
+// A process's data partitioning, changed while it runs by UpdatePartition.
+// Readers take a copy per query, so a change applies from the next query on.
+class LivePartitioning {
+public:
+    explicit LivePartitioning(DataPartitioning initial) : current_(std::move(initial)) {}
+
+    DataPartitioning get() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return current_;
+    }
+
+    // Apply an update (onto `base` instead of the current partitioning if given)
+    // and return the result
+    DataPartitioning apply(const firequery::PartitionUpdate& update, const DataPartitioning* base = nullptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (base) current_ = *base;
+        edit(current_.owned_dates, update.add_owned(), update.remove_owned());
+        edit(current_.replica_dates, update.add_replica(), update.remove_replica());
+        return current_;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    DataPartitioning current_;
+
+    template <typename Dates>
+    static void edit(std::vector<std::string>& dates, const Dates& add, const Dates& remove) {
+        for (const auto& date : remove) {
+            dates.erase(std::remove(dates.begin(), dates.end(), date), dates.end());
+        }
+        for (const auto& date : add) {
+            if (std::find(dates.begin(), dates.end(), date) == dates.end()) dates.push_back(date);
+        }
+        std::sort(dates.begin(), dates.end());
+    }
+};
+
+// Apply an UpdatePartition addressed to this process. Every added date must be
+// stored under our data path, otherwise nothing changes.
+inline void applyPartitionUpdate(const ProcessConfig& config, LivePartitioning& partitioning,
+                                 FireDataLoader& loader, const firequery::PartitionUpdate& update,
+                                 firequery::PartitionUpdateAck* ack) {
+    DataPartitioning reloaded;
+    if (update.reload()) {
+        try {
+            reloaded = ConfigParser::loadPartitioning(config.config_file);
+        } catch (const std::exception& e) {
+            ack->set_applied(false);
+            ack->set_message(e.what());
+            return;
+        }
+    }
+
+    std::vector<std::string> missing;
+    for (const auto* added : {&update.add_owned(), &update.add_replica()}) {
+        for (const auto& date : *added) {
+            if (loader.listFiles(date).empty()) missing.push_back(date);
+        }
+    }
+    if (!missing.empty()) {
+        std::string dates;
+        for (const auto& date : missing) dates += (dates.empty() ? "" : " ") + date;
+        ack->set_applied(false);
+        ack->set_message("not stored at " + config.process_id + ": " + dates);
+        return;
+    }
+
+    DataPartitioning result = partitioning.apply(update, update.reload() ? &reloaded : nullptr);
+    ack->set_applied(true);
+    for (const auto& date : result.owned_dates) ack->add_owned_dates(date);
+    for (const auto& date : result.replica_dates) ack->add_replica_dates(date);
+}
+
+// Report a process's scan costs in its partition entry
+inline void addDateCosts(ScanCostTable& costs, firequery::PartitionEntry* entry) {
+    for (const auto& [date, cost] : costs.snapshot()) {
+        auto* out = entry->add_date_costs();
+        out->set_date(date);
+        out->set_files(cost.files);
+        out->set_rows(cost.rows);
+        out->set_bytes(cost.bytes);
+        out->set_scan_us(cost.scan_us);
+    }
+}
+
+// Picks date migrations that even out the scan load of the processes owning
+// dates. A date's cost is the bytes scanned for it cluster-wide (so both its
+// size and how often it is queried count); a process's load is the cost of
+// its owned dates divided by its own scan throughput (bytes per microsecond),
+// so slower processes get less. Each move takes a date from the busiest
+// process to the one that leaves the lowest imbalance (busiest / mean load),
+// until the busiest is within max_imbalance of the mean or no move improves
+// the imbalance by at least kMinGain.
+class PartitionBalancer {
+public:
+    // Scanned bytes below which a process's throughput is not trusted yet
+    static constexpr int64_t kMinThroughputBytes = 1 << 20;
+    // Smallest relative imbalance reduction worth a migration
+    static constexpr double kMinGain = 0.02;
+
+    struct Move {
+        std::string date;
+        std::string from;
+        std::string to;
+    };
+
+    struct Plan {
+        std::vector<Move> moves;
+        double imbalance_before = 1.0;  // busiest load / mean load
+        double imbalance_after = 1.0;
+    };
+
+    void addProcess(const std::string& process_id, const std::vector<std::string>& owned,
+                    int64_t scanned_bytes, int64_t scan_us) {
+        Process& process = processes_[process_id];
+        process.owned.insert(owned.begin(), owned.end());
+        process.bytes += scanned_bytes;
+        process.scan_us += scan_us;
+    }
+
+    void addDateCost(const std::string& date, int64_t bytes) { cost_[date] += static_cast<double>(bytes); }
+
+    // Never move date to process_id (e.g. it does not store the date)
+    void exclude(const std::string& date, const std::string& process_id) {
+        excluded_.insert({date, process_id});
+    }
+
+    // Leave date where it is (e.g. it was just moved and its cost there is not known yet)
+    void pin(const std::string& date) { pinned_.insert(date); }
+
+    Plan plan(double max_imbalance, int max_moves) const {
+        Plan plan;
+        if (processes_.size() < 2) return plan;
+
+        std::map<std::string, double> speed = throughputs();
+        std::map<std::string, std::set<std::string>> owned;
+        std::map<std::string, double> load;
+        for (const auto& [process_id, process] : processes_) {
+            owned[process_id] = process.owned;
+            double total = 0.0;
+            for (const auto& date : process.owned) total += costOf(date);
+            load[process_id] = total / speed[process_id];
+        }
+
+        plan.imbalance_before = plan.imbalance_after = imbalance(load);
+        while (static_cast<int>(plan.moves.size()) < max_moves && plan.imbalance_after > max_imbalance) {
+            auto busiest = std::max_element(load.begin(), load.end(),
+                [](const auto& a, const auto& b) { return a.second < b.second; });
+            const std::string from = busiest->first;
+
+            const std::string* best_date = nullptr;
+            const std::string* best_to = nullptr;
+            double best_imbalance = plan.imbalance_after * (1.0 - kMinGain);
+            for (const auto& date : owned[from]) {
+                double cost = costOf(date);
+                if (cost <= 0.0 || pinned_.count(date)) continue;
+                for (auto& [to, to_load] : load) {
+                    if (to == from || excluded_.count({date, to})) continue;
+                    double from_before = load[from], to_before = to_load;
+                    load[from] -= cost / speed[from];
+                    to_load += cost / speed[to];
+                    double candidate = imbalance(load);
+                    load[from] = from_before;
+                    to_load = to_before;
+                    if (candidate < best_imbalance) {
+                        best_imbalance = candidate;
+                        best_date = &date;
+                        best_to = &to;
+                    }
+                }
+            }
+            if (!best_date) break;
+
+            Move move{*best_date, from, *best_to};
+            double cost = costOf(move.date);
+            load[move.from] -= cost / speed[move.from];
+            load[move.to] += cost / speed[move.to];
+            owned[move.from].erase(move.date);
+            owned[move.to].insert(move.date);
+            plan.moves.push_back(std::move(move));
+            plan.imbalance_after = imbalance(load);
+        }
+        return plan;
+    }
+
+private:
+    struct Process {
+        std::set<std::string> owned;
+        int64_t bytes = 0;
+        int64_t scan_us = 0;
+    };
+
+    std::map<std::string, Process> processes_;
+    std::map<std::string, double> cost_;
+    std::set<std::pair<std::string, std::string>> excluded_;
+    std::set<std::string> pinned_;
+
+    double costOf(const std::string& date) const {
+        auto it = cost_.find(date);
+        return it == cost_.end() ? 0.0 : it->second;
+    }
+
+    // Bytes per microsecond of each process; the median of the measured ones
+    // stands in for processes that have not scanned enough yet
+    std::map<std::string, double> throughputs() const {
+        std::vector<double> measured;
+        for (const auto& [process_id, process] : processes_) {
+            if (process.bytes >= kMinThroughputBytes && process.scan_us > 0) {
+                measured.push_back(static_cast<double>(process.bytes) / static_cast<double>(process.scan_us));
+            }
+        }
+        double fallback = 1.0;
+        if (!measured.empty()) {
+            std::nth_element(measured.begin(), measured.begin() + measured.size() / 2, measured.end());
+            fallback = measured[measured.size() / 2];
+        }
+
+        std::map<std::string, double> speed;
+        for (const auto& [process_id, process] : processes_) {
+            bool known = process.bytes >= kMinThroughputBytes && process.scan_us > 0;
+            speed[process_id] = known ? static_cast<double>(process.bytes) / static_cast<double>(process.scan_us)
+                                      : fallback;
+        }
+        return speed;
+    }
+
+    static double imbalance(const std::map<std::string, double>& load) {
+        double total = 0.0, peak = 0.0;
+        for (const auto& [process_id, value] : load) {
+            total += value;
+            peak = std::max(peak, value);
+        }
+        if (total <= 0.0) return 1.0;
+        return peak / (total / static_cast<double>(load.size()));
+    }
+};
+
+#endif // REPARTITIONING_HPP
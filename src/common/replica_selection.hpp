@@ -0,0 +1,85 @@
+#ifndef REPLICA_SELECTION_HPP
+#define REPLICA_SELECTION_HPP
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "config.hpp"
+
+// Dates a process serves for a query range. Without targets that is its owned
+// dates in range; with targets (set by whoever picked the replicas) it is the
+// targeted dates it holds, owned or replica.
+template <typename Targets>
+inline std::vector<std::string> selectServedDates(const DataPartitioning& partitioning,
+                                                  const std::string& date_start,
+                                                  const std::string& date_end,
+                                                  const Targets& targets) {
+    std::vector<std::string> result;
+    auto consider = [&](const std::string& date) {
+        if (date < date_start || date > date_end) return;
+        if (!targets.empty() && std::find(targets.begin(), targets.end(), date) == targets.end()) return;
+        if (std::find(result.begin(), result.end(), date) == result.end()) result.push_back(date);
+    };
+    for (const auto& date : partitioning.owned_dates) consider(date);
+    if (!targets.empty()) {
+        for (const auto& date : partitioning.replica_dates) consider(date);
+    }
+    return result;
+}
+
+// Picks one holder per date when dates are replicated
+// (data_partitioning.replica_dates). Dates are assigned in order to the holder
+// with the lowest score: its live load score (StatusManager::loadScore, in
+// busy requests) weighted by kLoadWeight plus the dates already given to it by
+// this plan, so a multi-date query is split across replicas. Ties go to the
+// holder added first (callers add the primary owner before replicas).
+class ReplicaPlanner {
+public:
+    // One busy request counts as this many dates of work
+    static constexpr double kLoadWeight = 4.0;
+
+    using LoadProbe = std::function<double(const std::string& process_id)>;
+
+    explicit ReplicaPlanner(LoadProbe load) : load_(std::move(load)) {}
+
+    void addHolder(const std::string& date, const std::string& process_id) {
+        auto& holders = holders_[date];
+        if (std::find(holders.begin(), holders.end(), process_id) == holders.end()) {
+            holders.push_back(process_id);
+        }
+    }
+
+    bool empty() const { return holders_.empty(); }
+
+    // process id -> dates it should serve, each date given to exactly one holder
+    std::map<std::string, std::vector<std::string>> assign() const {
+        std::map<std::string, double> score;
+        std::map<std::string, std::vector<std::string>> plan;
+        for (const auto& [date, holders] : holders_) {
+            const std::string* best = nullptr;
+            double best_score = 0.0;
+            for (const auto& process_id : holders) {
+                auto it = score.find(process_id);
+                if (it == score.end()) {
+                    it = score.emplace(process_id, std::max(0.0, load_(process_id)) * kLoadWeight).first;
+                }
+                if (!best || it->second < best_score) {
+                    best = &process_id;
+                    best_score = it->second;
+                }
+            }
+            score[*best] += 1.0;
+            plan[*best].push_back(date);
+        }
+        return plan;
+    }
+
+private:
+    LoadProbe load_;
+    std::map<std::string, std::vector<std::string>> holders_;  // date -> holders, primary first
+};
+
+#endif // REPLICA_SELECTION_HPP
@@ -0,0 +1,41 @@
+#ifndef SCAN_COSTS_HPP
+#define SCAN_COSTS_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+// What scanning one date has cost this process so far
+struct DateScanCost {
+    int64_t files = 0;
+    int64_t rows = 0;      // lines parsed
+    int64_t bytes = 0;
+    int64_t scan_us = 0;   // reading and parsing only, not time blocked on the consumer
+};
+
+// Per-date scan cost of every scan this process ran, reported in its
+// partition entry so the leader can rebalance date ownership
+class ScanCostTable {
+public:
+    void record(const std::string& date, int64_t rows, int64_t bytes, std::chrono::microseconds elapsed) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        DateScanCost& cost = costs_[date];
+        cost.files++;
+        cost.rows += rows;
+        cost.bytes += bytes;
+        cost.scan_us += elapsed.count();
+    }
+
+    std::map<std::string, DateScanCost> snapshot() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return costs_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::map<std::string, DateScanCost> costs_;
+};
+
+#endif // SCAN_COSTS_HPP
@@ -0,0 +1,149 @@
+#ifndef WORK_STEALING_HPP
+#define WORK_STEALING_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+// One unit of scan work: an hour file of a date ("" = the whole date)
+struct ScanTask {
+    std::string date;
+    std::string file;  // relative to the data path, e.g. "20200810/20200810-01.csv"
+};
+
+// Scan tasks of one delegation, queued per team member. A member takes its
+// own tasks from the front of its queue; once that is empty it steals from
+// the back of the queue with the most tasks it is allowed to run, so the
+// team finishes when its total work is done rather than when its slowest
+// member is. Every claim ends in done() or fail(); a failed task goes back
+// on the board for the members still up, so the board only runs dry once
+// every task is done or none left can be run by a member that has not failed.
+class TaskBoard {
+public:
+    // Whether a member can run a task (holds its date, or the team shares storage)
+    using Eligible = std::function<bool(const std::string& member, const ScanTask& task)>;
+
+    struct Claim {
+        ScanTask task;
+        std::string owner;  // member whose queue it came from
+    };
+
+    explicit TaskBoard(Eligible eligible) : eligible_(std::move(eligible)) {}
+
+    void add(const std::string& owner, ScanTask task) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queues_[owner].push_back(std::move(task));
+    }
+
+    // Next task for member. While other claims are still running it waits
+    // for one of them to fail back onto the board; nullopt once nothing is
+    // left the member can run, the member has failed, or stop() is true.
+    std::optional<Claim> next(const std::string& member, const std::function<bool()>& stop) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop() && !failed_.count(member)) {
+            if (auto claim = take(member)) {
+                running_++;
+                return claim;
+            }
+            if (running_ == 0) break;
+            changed_.wait_for(lock, kStopCheckInterval);
+        }
+        return std::nullopt;
+    }
+
+    // The claim finished (or was abandoned along with its request)
+    void done() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_--;
+        changed_.notify_all();
+    }
+
+    // The claim failed on member, which takes no more tasks. Unless it had
+    // already sent part of its rows, the task goes back for the others.
+    void fail(const std::string& member, Claim claim, bool partial) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_--;
+        failed_.insert(member);
+        if (partial) {
+            lost_++;
+        } else {
+            queues_[claim.owner].push_back(std::move(claim.task));
+        }
+        changed_.notify_all();
+    }
+
+    size_t remaining() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t total = 0;
+        for (const auto& [owner, queue] : queues_) total += queue.size();
+        return total;
+    }
+
+    int stolen() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stolen_;
+    }
+
+    // Tasks that failed after sending part of their rows, so can't be retried
+    int lost() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return lost_;
+    }
+
+private:
+    // How often a member waiting for a task re-checks stop()
+    static constexpr auto kStopCheckInterval = std::chrono::milliseconds(50);
+
+    Eligible eligible_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::map<std::string, std::deque<ScanTask>> queues_;
+    std::set<std::string> failed_;
+    int running_ = 0;
+    int stolen_ = 0;
+    int lost_ = 0;
+
+    // Own task first, else one stolen from the fullest queue; caller holds the lock
+    std::optional<Claim> take(const std::string& member) {
+        auto own = queues_.find(member);
+        if (own != queues_.end() && !own->second.empty()) {
+            Claim claim{std::move(own->second.front()), member};
+            own->second.pop_front();
+            return claim;
+        }
+
+        std::deque<ScanTask>* victim = nullptr;
+        const std::string* victim_id = nullptr;
+        size_t most = 0;
+        for (auto& [owner, queue] : queues_) {
+            if (owner == member) continue;
+            size_t stealable = static_cast<size_t>(std::count_if(queue.begin(), queue.end(),
+                [&](const ScanTask& task) { return eligible_(member, task); }));
+            if (stealable > most) {
+                most = stealable;
+                victim = &queue;
+                victim_id = &owner;
+            }
+        }
+        if (!victim) return std::nullopt;
+
+        for (auto it = victim->rbegin(); it != victim->rend(); ++it) {
+            if (!eligible_(member, *it)) continue;
+            Claim claim{std::move(*it), *victim_id};
+            victim->erase(std::next(it).base());
+            stolen_++;
+            return claim;
+        }
+        return std::nullopt;
+    }
+};
+
+#endif // WORK_STEALING_HPP
@@ -1,15 +1,17 @@
 #include <iostream>
 #include <memory>
 #include <string>
-#include <thread>
 #include <chrono>
+#include <cstdio>
 #include <map>
 #include <mutex>
-#include <queue>
+#include <deque>
 #include <vector>
 #include <atomic>
+#include <set>
+#include <algorithm>
+#include <thread>
 #include <condition_variable>
-#include <unordered_map>
 
 #include <grpc/grpc.h>
 #include <grpcpp/server.h>
@@ -17,17 +19,34 @@
 #include <grpcpp/server_context.h>
 #include <grpcpp/security/server_credentials.h>
 #include <grpcpp/create_channel.h>
+#include <grpcpp/support/server_callback.h>
+#include <grpcpp/support/client_callback.h>
+
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 
 #include "fire_query.grpc.pb.h"
 #include "../../common/config.hpp"
 #include "../../common/fire_data_loader.hpp"
+#include "../../common/record_batch.hpp"
+#include "../../common/compression.hpp"
+#include "../../common/cancellation.hpp"
+#include "../../common/flow_control.hpp"
+#include "../../common/channel_pool.hpp"
+#include "../../common/replica_selection.hpp"
+#include "../../common/admission.hpp"
+#include "../../common/repartitioning.hpp"
 #include "../../shmem/status_manager.hpp"
+#include "../../shmem/load_sampler.hpp"
+#include "../../shmem/chunk_ring.hpp"
 #include "../../common/metrics.hpp"
 
 using grpc::Server;
 using grpc::ServerBuilder;
-using grpc::ServerContext;
-using grpc::ServerWriter;
+using grpc::CallbackServerContext;
+using grpc::ServerWriteReactor;
+using grpc::ServerUnaryReactor;
+using grpc::ClientReadReactor;
 using grpc::Status;
 using grpc::Channel;
 using grpc::ClientContext;
@@ -42,132 +61,327 @@ using firequery::DelegationResponse;
 using firequery::CancelRequest;
 using firequery::CancelResponse;
 using firequery::FireRecord;
+using firequery::PartitionMapRequest;
+using firequery::PartitionMapResponse;
+using firequery::PartitionUpdate;
+using firequery::PartitionUpdateAck;
+using firequery::RoutingPlan;
+
+class LeaderServiceImpl;
+class SharedQuery;
+class QueryFireReactor;
 
 // ==========================
-// Bounded, thread-safe queue
+// Per-team delegation stream
 // ==========================
-template<typename T>
-class ThreadSafeQueue {
+// Reads one team leader's DelegateQuery stream with the callback API. Only one
+// read is outstanding at a time and reads pause while the team's relay buffer
+// is full, so a slow client backpressures the team through HTTP/2 flow control.
+class TeamStream final : public ClientReadReactor<DelegationResponse> {
 public:
-    explicit ThreadSafeQueue(size_t capacity = 32) : capacity_(capacity) {}
-
-    // Move ctor/assign
-    ThreadSafeQueue(ThreadSafeQueue&& other) noexcept {
-        std::scoped_lock lk(mutex_, other.mutex_);
-        queue_     = std::move(other.queue_);
-        finished_  = other.finished_;
-        capacity_  = other.capacity_;
-    }
-    ThreadSafeQueue& operator=(ThreadSafeQueue&& other) noexcept {
-        if (this != &other) {
-            std::scoped_lock lk(mutex_, other.mutex_);
-            queue_     = std::move(other.queue_);
-            finished_  = other.finished_;
-            capacity_  = other.capacity_;
-        }
-        return *this;
-    }
-
-    ThreadSafeQueue(const ThreadSafeQueue&) = delete;
-    ThreadSafeQueue& operator=(const ThreadSafeQueue&) = delete;
-
-    // Blocking push with backpressure. Returns false if finished while waiting.
-    bool push(const T& item) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        not_full_cv_.wait(lock, [this](){ return finished_ || queue_.size() < capacity_; });
-        if (finished_) return false;
-        queue_.push(item);
-        not_empty_cv_.notify_one();
-        return true;
-    }
-    bool push(T&& item) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        not_full_cv_.wait(lock, [this](){ return finished_ || queue_.size() < capacity_; });
-        if (finished_) return false;
-        queue_.push(std::move(item));
-        not_empty_cv_.notify_one();
-        return true;
+    TeamStream(SharedQuery* owner,
+               const std::string& team_name,
+               const std::string& team_leader_id,
+               int weight,
+               ChannelPool::Lease channel,
+               const DelegationRequest& request)
+        : team_name(team_name), team_leader_id(team_leader_id), weight(weight),
+          credit(request.initial_credit()), owner_(owner), channel_(std::move(channel)),
+          request_(request), ring_(request.shm_ring_stream()) {}
+
+    TeamStream(const TeamStream&) = delete;
+    TeamStream& operator=(const TeamStream&) = delete;
+
+    void start() {
+        channel_.stub()->async()->DelegateQuery(&context, &request_, this);
+        AddHold();  // reads are resumed from outside reactions; released at end of stream
+        StartRead(&incoming_);
+        StartCall();
     }
 
-    // Try-pop (non-blocking)
-    bool try_pop(T& item) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (queue_.empty()) return false;
-        item = std::move(queue_.front());
-        queue_.pop();
-        not_full_cv_.notify_one();
-        return true;
-    }
+    void resumeRead() { StartRead(&incoming_); }
 
-    // Wait up to rel_time; returns true if popped an item
-    template<typename Rep, typename Period>
-    bool wait_pop_for(T& item, const std::chrono::duration<Rep, Period>& rel_time) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        if (!not_empty_cv_.wait_for(lock, rel_time, [this](){ return finished_ || !queue_.empty(); })) {
-            return false;
+    // Give credit for relayed chunks back to the team leader
+    void returnCredit(int chunks) {
+        if (chunks > 0) {
+            grantCreditAsync(channel_.stub(), request_.request_id(), request_.delegating_process(),
+                             request_.credit_stream(), chunks);
         }
-        if (queue_.empty()) return false;
-        item = std::move(queue_.front());
-        queue_.pop();
-        not_full_cv_.notify_one();
-        return true;
     }
 
-    bool empty() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.empty();
+    void OnReadDone(bool ok) override;
+    void OnDone(const Status& status) override;
+
+    const std::string team_name;
+    const std::string team_leader_id;
+    const int weight;  // chunks relayed per round-robin turn
+    ClientContext context;
+
+    // Guarded by the owning SharedQuery's mutex
+    std::deque<DelegationResponse> buffer;  // bounded by SharedQuery::kTeamBufferChunks
+    bool read_paused = false;
+    bool done = false;
+    bool finish_logged = false;
+    int chunks_sent = 0;
+    long long records_sent = 0;
+    CreditReturner credit;
+
+private:
+    SharedQuery* owner_;
+    ChannelPool::Lease channel_;  // held for the stream's lifetime
+    DelegationRequest request_;
+    DelegationResponse incoming_;
+    ChunkRingReader ring_;  // chunks the team leader passes through shared memory
+};
+
+// ==========================
+// Shared query execution
+// ==========================
+// One fan-out of a RELAY query to the teams. Identical queries arriving while
+// it is young attach to it instead of fanning out again (coalescing). Team
+// chunks are merged weighted round-robin (a team with buffered data sends up
+// to its relay_weight chunks before the next team) into a log of client
+// envelopes, and every attached client stream writes from its own cursor into
+// that log. While joiners are accepted the log is kept from chunk 0, so a late
+// joiner replays what the others already got; afterwards only entries the
+// slowest client has not written are kept. Teams are drained only while the
+// slowest client is less than kTeamBufferChunks behind, so a slow client
+// backpressures the teams. Team reads and client writes are events on gRPC's
+// callback threads; no thread is created or blocked per query. Deletes itself
+// once every team stream and client stream is done.
+class SharedQuery {
+public:
+    static constexpr size_t kTeamBufferChunks = 32;
+
+    // What a client stream should write next
+    struct Next {
+        std::shared_ptr<QueryResponse> chunk;  // null: nothing to write yet, or the final
+        bool owned = false;                    // nobody else reads `chunk`; it may be moved from
+        bool final = false;                    // every chunk is written: send the final
+        int chunk_count = 0;
+        int total_records = 0;
+    };
+
+    // replay_chunks > 0: accept joiners until the log grows past this many chunks
+    SharedQuery(LeaderServiceImpl* service, const QueryRequest& request, std::string key, int replay_chunks)
+        : service_(service), request_(request), key_(std::move(key)),
+          replay_chunks_(replay_chunks), joinable_(replay_chunks > 0) {}
+    ~SharedQuery();
+
+    SharedQuery(const SharedQuery&) = delete;
+    SharedQuery& operator=(const SharedQuery&) = delete;
+
+    void addTeam(const std::string& team_name, const std::string& team_leader_id, int weight,
+                 ChannelPool::Lease channel, const DelegationRequest& request) {
+        request_window_ = request.initial_credit();
+        teams_.push_back(std::make_unique<TeamStream>(this, team_name, team_leader_id, weight,
+                                                      std::move(channel), request));
     }
 
-    void set_finished() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        finished_ = true;
-        not_empty_cv_.notify_all();
-        not_full_cv_.notify_all();
+    // Add a client stream at chunk 0. False once joiners are no longer accepted.
+    bool attach(QueryFireReactor* client);
+    // Remove a client stream; the last one to leave cancels the execution
+    void detach(QueryFireReactor* client);
+
+    // Hand the execution to admission control; it starts now, waits in the queue or is rejected
+    AdmissionScheduler::Decision admit(const std::string& tenant, int weight, double cost);
+    // Called by admission control once the query may fan out
+    void start(const AdmissionScheduler::Admission& admission);
+
+    // The entry at the client's cursor; the cursor moves on advance()
+    Next next(QueryFireReactor* client);
+    // The client wrote its next entry
+    void advance(QueryFireReactor* client);
+
+    void onTeamChunk(TeamStream* team, DelegationResponse&& chunk);
+    void onTeamDone(TeamStream* team, const Status& status);
+
+    const std::string& requestId() const { return request_.request_id(); }
+    void release() {
+        if (--outstanding_ == 0) delete this;
     }
 
-    bool is_finished() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return finished_ && queue_.empty();
+private:
+    // gRPC calls and client wake-ups decided under the mutex, run after it is released
+    struct Effects {
+        std::vector<TeamStream*> resume;
+        std::vector<std::pair<TeamStream*, int>> credit;
+        std::vector<QueryFireReactor*> wake;  // each holds a reference until woken
+        bool forget = false;                  // joiners are no longer accepted
+    };
+
+    LeaderServiceImpl* service_;
+    QueryRequest request_;
+    const std::string key_;
+    const size_t replay_chunks_;
+    std::vector<std::unique_ptr<TeamStream>> teams_;
+    std::atomic<int> outstanding_{1};   // creator, clients, admission queue, team streams
+    uint64_t admission_id_ = 0;
+    int request_window_ = 0;            // credit window given to each team (0 = off)
+
+    std::mutex mutex_;
+    std::deque<std::shared_ptr<QueryResponse>> log_;
+    size_t log_base_ = 0;               // chunk number of log_.front()
+    std::map<QueryFireReactor*, size_t> cursors_;  // next chunk each client writes
+    bool joinable_;
+    bool closing_ = false;              // no clients left (or rejected): drop everything
+    bool started_ = false;
+    bool queued_ = false;               // waiting in admission control
+    bool admitted_ = false;             // holds an admission slot until deleted
+    bool interactive_slot_ = false;     // ...from the interactive reserve
+    size_t next_team_ = 0;              // team whose turn it is
+    int burst_ = 0;                     // chunks sent in the current turn
+    int total_records_ = 0;
+
+    size_t logEndLocked() const { return log_base_ + log_.size(); }
+    size_t slowestLocked() const;
+    bool completeLocked() const;
+    void pumpLocked(Effects& fx);
+    void wakeLocked(Effects& fx, QueryFireReactor* except);
+    void run(Effects& fx);
+    void cancelTeams();
+    void logTeamFinishLocked(TeamStream& team);
+};
+
+// ==========================
+// Client-facing query stream
+// ==========================
+// One QueryFire call, attached to the SharedQuery executing it. Writes the
+// execution's chunks in order under its own request id, then the final chunk.
+// Deletes itself once the call is done and no wake-up still refers to it.
+class QueryFireReactor final : public ServerWriteReactor<QueryResponse> {
+public:
+    QueryFireReactor(LeaderServiceImpl* service, CallbackServerContext* context,
+                     const QueryRequest& request)
+        : service_(service), request_(request) {
+        // CancelQuery cancels the client call; OnCancel then detaches from the
+        // execution, which is cancelled down to the workers once nobody is left
+        cancel_handle_ = CancellationRegistry::instance().add(
+            request_.request_id(), CancellationToken(), [context]() { context->TryCancel(); });
+    }
+
+    // Attach to an execution; false if it no longer accepts joiners
+    bool attachTo(SharedQuery* upstream);
+
+    // Start writing the next entry if none is in flight
+    void maybeWrite();
+
+    // Admission control turned the execution away
+    void reject(const Status& status) { finishOnce(status); }
+
+    const std::string& requestId() const { return request_.request_id(); }
+    void hold() { outstanding_++; }
+    void release() {
+        if (--outstanding_ == 0) delete this;
     }
 
-    size_t capacity() const { return capacity_; }
+    void OnWriteDone(bool ok) override;
+    void OnCancel() override;
+    void OnDone() override;
 
 private:
-    mutable std::mutex mutex_;
-    std::queue<T> queue_;
-    std::condition_variable not_empty_cv_;
-    std::condition_variable not_full_cv_;
+    LeaderServiceImpl* service_;
+    QueryRequest request_;
+    SharedQuery* upstream_ = nullptr;
+    std::atomic<int> outstanding_{1};
+    uint64_t cancel_handle_ = 0;
+
+    std::mutex mutex_;
+    QueryResponse out_;                 // message of the write in flight
+    int out_records_ = 0;
+    bool attached_ = false;
+    bool write_in_flight_ = false;
+    bool final_started_ = false;
     bool finished_ = false;
-    size_t capacity_;
+    bool finish_deferred_ = false;      // Finish waits for the write in flight
+    Status deferred_status_;
+    bool succeeded_ = false;
+    int total_records_ = 0;
+
+    void detach();
+    void writeFinished();
+    void finishOnce(const Status& status);
 };
 
 // ==========================
-// Per-team stream container
+// DIRECT delivery: routing plan
 // ==========================
-struct TeamReader {
-    std::string team_name;
-    std::string team_leader_id;
-    std::unique_ptr<ClientContext> context;
-    std::unique_ptr<grpc::ClientReader<DelegationResponse>> reader;
-    ThreadSafeQueue<DelegationResponse> buffer{32}; // bounded buffer
-    std::atomic<bool> finished{false};
-    std::atomic<bool> error_occurred{false};
-    Status finish_status;
-
-    TeamReader() = default;
-    // TeamReader(TeamReader&&) = default;
-    // TeamReader& operator=(TeamReader&&) = default;
-    TeamReader(const TeamReader&) = delete;
-    TeamReader& operator=(const TeamReader&) = delete;
+// Collects the partition map of every team (team leader + workers) and answers
+// the query with a single final message carrying a RoutingPlan. The client then
+// fetches each route straight from its owner; no records pass through the leader.
+// Plans go through admission control like relayed queries, holding a slot
+// until the plan is sent: the leader never sees the fetch itself, so it is
+// left to the limits of the processes serving it.
+class RoutingPlanReactor final : public ServerWriteReactor<QueryResponse> {
+public:
+    RoutingPlanReactor(LeaderServiceImpl* service, CallbackServerContext* context, const QueryRequest& request)
+        : service_(service), request_(request) {
+        cancel_handle_ = CancellationRegistry::instance().add(
+            request_.request_id(), CancellationToken(), [context]() { context->TryCancel(); });
+    }
+
+    void addTeamLeader(const std::string& team_leader_id, const std::string& address,
+                       ChannelPool::Lease channel) {
+        auto call = std::make_unique<MapCall>();
+        call->team_leader_id = team_leader_id;
+        call->address = address;
+        call->channel = std::move(channel);
+        calls_.push_back(std::move(call));
+    }
+
+    // Build the plan once admission control lets it start
+    void admit(const std::string& tenant, int weight, double cost);
+
+    void OnWriteDone(bool ok) override;
+    void OnCancel() override;
+    void OnDone() override;
+
+private:
+    struct MapCall {
+        std::string team_leader_id;
+        std::string address;
+        ChannelPool::Lease channel;
+        ClientContext context;
+        PartitionMapRequest request;
+        PartitionMapResponse response;
+        Status status;
+    };
+
+    LeaderServiceImpl* service_;
+    QueryRequest request_;
+    std::vector<std::unique_ptr<MapCall>> calls_;
+    std::atomic<int> remaining_{0};
+    QueryResponse out_;
+    bool succeeded_ = false;
+    uint64_t cancel_handle_ = 0;
+    uint64_t admission_id_ = 0;
+    std::atomic<bool> admitted_{false};
+    bool interactive_slot_ = false;
+
+    void start(const AdmissionScheduler::Admission& admission);
+    void sendPlan();
+};
+
+// A server stream that is rejected before any message is written
+template <typename Response>
+class RejectedStream final : public ServerWriteReactor<Response> {
+public:
+    explicit RejectedStream(const Status& status) { this->Finish(status); }
+    void OnDone() override { delete this; }
 };
 
 // ==========================
 // Leader service
 // ==========================
-class LeaderServiceImpl final : public FireQueryService::Service {
+class LeaderServiceImpl final : public FireQueryService::CallbackService {
 public:
     LeaderServiceImpl(const ProcessConfig& config)
-        : config_(config), status_mgr_(true), request_counter_(0) {
+        : config_(config), status_mgr_(true, config.status_slots > 0 ? config.status_slots : kDefaultStatusSlots),
+          admission_(config.admission_config.max_inflight_queries,
+                     config.admission_config.max_queued_queries,
+                     config.admission_config.interactive_slots,
+                     config.admission_config.interactive_max_cost),
+          request_counter_(0) {
 
         std::cout << "Leader Process " << config_.process_id << " starting...\n";
         std::cout << "Listening on " << config_.listen_host << ":" << config_.listen_port << std::endl;
@@ -175,18 +389,47 @@ public:
         // Create gRPC clients to team leaders
         for (const auto& edge : config_.edges) {
             std::string target = edge.host + ":" + std::to_string(edge.port);
-            auto channel = grpc::CreateChannel(target, grpc::InsecureChannelCredentials());
-            team_leader_stubs_[edge.to] = FireQueryService::NewStub(channel);
-            std::cout << "Connected to team leader " << edge.to << " (" << edge.team << ") at " << target << std::endl;
+            team_leader_pools_[edge.to] = std::make_unique<ChannelPool>(target, edge.channel_pool_size);
+            team_leader_compression_[edge.to] = parseCompressionPolicy(edge.compression);
+            team_leader_weight_[edge.to] = edge.relay_weight;
+            team_leader_ring_bytes_[edge.to] = chunkRingBytes(edge);
+            team_leader_address_[edge.to] = target;
+            std::cout << "Connected to team leader " << edge.to << " (" << edge.team << ") at " << target
+                      << " (compression: " << edge.compression
+                      << ", relay weight: " << edge.relay_weight
+                      << ", transport: " << (team_leader_ring_bytes_[edge.to] > 0 ? "shm" : "grpc")
+                      << ", connections: " << edge.channel_pool_size << ")" << std::endl;
         }
 
         // Initialize metrics logging for this process
         metrics::init_with_dir("logs", config_.process_id, config_.role);
+
+        // Take our slot in the shared status registry and keep our load in it current
+        status_mgr_.registerProcess(config_.process_id, config_.team);
+        load_sampler_ = std::make_unique<LoadSampler>(status_mgr_, config_.process_id, config_.load_sample_ms,
+            [this]() { return LoadSampler::Gauges{admission_.queued(), 0}; });
+
+        // Learn the cluster's date partitions; teams that are not up yet are asked again later
+        for (const auto& edge : config_.edges) {
+            refreshPartitionMap(edge.to);
+        }
+
+        if (config_.repartition_config.interval_s > 0) {
+            rebalancer_ = std::thread([this]() { rebalanceLoop(); });
+        }
     }
 
-    Status QueryFire(ServerContext* context,
-                     const QueryRequest* request,
-                     ServerWriter<QueryResponse>* writer) override {
+    ~LeaderServiceImpl() {
+        {
+            std::lock_guard<std::mutex> lock(rebalance_mutex_);
+            stopping_ = true;
+        }
+        rebalance_cv_.notify_all();
+        if (rebalancer_.joinable()) rebalancer_.join();
+    }
+
+    ServerWriteReactor<QueryResponse>* QueryFire(CallbackServerContext* context,
+                                                 const QueryRequest* request) override {
 
         std::cout << "\n[Leader] Received query " << request->request_id() << std::endl;
         std::cout << "  Date range: " << request->date_start() << " to " << request->date_end() << std::endl;
@@ -200,15 +443,50 @@ public:
 
         metrics::log_event("ENQUEUE", request->request_id(), pending_requests_, 1, -1, -1, "received at leader");
 
-        // Teams to query (kept simple: both teams)
-        std::vector<std::string> teams_to_query = selectTeamsForQuery(request);
+        if (request->delivery_mode() == firequery::DIRECT) {
+            std::cout << "  Direct delivery: building routing plan" << std::endl;
+            auto* reactor = new RoutingPlanReactor(this, context, *request);
+            for (const auto& [team_name, dates] : selectTeamsForQuery(request)) {
+                std::string team_leader_id = getTeamLeader(team_name);
+                auto it = team_leader_pools_.find(team_leader_id);
+                if (it == team_leader_pools_.end()) continue;
+                reactor->addTeamLeader(team_leader_id, team_leader_address_[team_leader_id], it->second->acquire());
+            }
+            reactor->admit(tenantOf(context, *request), std::max(1, request->priority()), estimateQueryCost(*request));
+            return reactor;
+        }
+
+        auto* reactor = new QueryFireReactor(this, context, *request);
+
+        // An identical query already running takes this client along
+        std::string key;
+        if (config_.admission_config.coalesce_replay_chunks > 0) {
+            key = coalescingKey(*request);
+            std::string joined;
+            {
+                std::lock_guard<std::mutex> lock(shared_queries_mutex_);
+                auto it = shared_queries_.find(key);
+                if (it != shared_queries_.end() && reactor->attachTo(it->second)) joined = it->second->requestId();
+            }
+            if (!joined.empty()) {
+                metrics::log_event("COALESCE_JOIN", request->request_id(), pending_requests_, 1, -1, -1,
+                                   "upstream=" + joined);
+                std::cout << "  Coalesced with in-flight query " << joined << std::endl;
+                reactor->maybeWrite();  // replay what the execution already has
+                return reactor;
+            }
+        }
+
+        // Teams holding the query's dates, each with the dates it should serve
+        std::map<std::string, std::vector<std::string>> teams_to_query = selectTeamsForQuery(request);
         std::cout << "  Delegating to teams: ";
-        for (const auto& t : teams_to_query) std::cout << t << " ";
+        for (const auto& [team_name, dates] : teams_to_query) {
+            std::cout << team_name;
+            if (!dates.empty()) std::cout << "(" << dates.size() << " dates)";
+            std::cout << " ";
+        }
         std::cout << std::endl;
 
-        int total_chunk_number = 0;
-        int total_records = 0;
-
         metrics::log_event("START_DELEGATE", request->request_id(), pending_requests_, 1, -1, -1, "delegating to teams");
 
         // Prepare delegation request
@@ -219,255 +497,1090 @@ public:
         request->SerializeToString(&serialized_query);
         delegation_req.set_original_query(serialized_query);
 
-        // Open all team streams
-        std::vector<std::unique_ptr<TeamReader>> team_readers;
-        std::vector<std::thread> reader_threads;
+        auto* shared = new SharedQuery(this, *request, key, config_.admission_config.coalesce_replay_chunks);
 
-        for (const auto& team_name : teams_to_query) {
+        // Open all team streams
+        for (const auto& [team_name, dates] : teams_to_query) {
             std::string team_leader_id = getTeamLeader(team_name);
             if (team_leader_id.empty()) {
                 std::cerr << "[Leader] No team leader for team: " << team_name << std::endl;
                 continue;
             }
-            auto it = team_leader_stubs_.find(team_leader_id);
-            if (it == team_leader_stubs_.end()) {
+            auto it = team_leader_pools_.find(team_leader_id);
+            if (it == team_leader_pools_.end()) {
                 std::cerr << "[Leader] No stub for TL: " << team_leader_id << std::endl;
                 continue;
             }
 
-            auto tr = std::make_unique<TeamReader>();
-            tr->team_name = team_name;
-            tr->team_leader_id = team_leader_id;
-            tr->context = std::make_unique<ClientContext>();
-            tr->reader = it->second->DelegateQuery(tr->context.get(), delegation_req);
-            team_readers.push_back(std::move(tr));
-        }
-
-        // Per-team relay counters (for TEAM_FINISH)
-        std::unordered_map<std::string, int> team_chunks_sent;
-        std::unordered_map<std::string, long long> team_records_sent;
-        std::unordered_map<std::string, bool> team_finish_logged;
-
-        for (auto& tr : team_readers) {
-            team_chunks_sent[tr->team_name] = 0;
-            team_records_sent[tr->team_name] = 0;
-            team_finish_logged[tr->team_name] = false;
-        }
-
-        // Shared cancellation
-        std::atomic<bool> cancel_requested{false};
-
-        // Reader threads: read -> bounded push
-        for (size_t i = 0; i < team_readers.size(); ++i) {
-            reader_threads.emplace_back([&team_readers, i, &cancel_requested]() {
-                TeamReader& r = *team_readers[i];
-                DelegationResponse chunk;
-                while (!cancel_requested.load() && r.reader->Read(&chunk)) {
-                    // push blocks if buffer full; returns false if finished while waiting
-                    if (!r.buffer.push(std::move(chunk))) {
-                        break;
+            DelegationRequest team_req = delegation_req;
+            team_req.set_response_compression(team_leader_compression_[team_leader_id]);
+            team_req.set_initial_credit(config_.chunk_config.credit_window);
+            team_req.set_credit_stream(newCreditStream());
+            team_req.set_shm_ring_bytes(team_leader_ring_bytes_[team_leader_id]);
+            team_req.set_shm_ring_stream(newChunkRingStream());
+            for (const auto& date : dates) team_req.add_target_dates(date);
+            shared->addTeam(team_name, team_leader_id, team_leader_weight_[team_leader_id],
+                            it->second->acquire(), team_req);
+        }
+        reactor->attachTo(shared);
+        if (!key.empty()) {
+            std::lock_guard<std::mutex> lock(shared_queries_mutex_);
+            shared_queries_[key] = shared;
+        }
+
+        shared->admit(tenantOf(context, *request), std::max(1, request->priority()), estimateQueryCost(*request));
+        shared->release();  // the clients, queue and teams hold it from here
+        return reactor;
+    }
+
+    ServerUnaryReactor* HealthCheck(CallbackServerContext* context,
+                                    const HealthRequest*,
+                                    HealthResponse* response) override {
+        response->set_responding_process(config_.process_id);
+        response->set_is_healthy(true);
+        response->set_pending_requests(pending_requests_);
+        response->set_active_workers(1);
+
+        ServerUnaryReactor* reactor = context->DefaultReactor();
+        reactor->Finish(Status::OK);
+        return reactor;
+    }
+
+    ServerUnaryReactor* CancelQuery(CallbackServerContext* context,
+                                    const CancelRequest* request,
+                                    CancelResponse* response) override {
+        int found = CancellationRegistry::instance().cancel(request->request_id());
+        std::cout << "[Leader] Received cancel for " << request->request_id()
+                  << " (" << found << " in flight)" << std::endl;
+        response->set_request_id(request->request_id());
+        response->set_cancelled(found > 0);
+        response->set_message(found > 0 ? "Query cancelled" : "Query not in flight");
+
+        ServerUnaryReactor* reactor = context->DefaultReactor();
+        reactor->Finish(Status::OK);
+        return reactor;
+    }
+
+    ServerWriteReactor<DelegationResponse>* DelegateQuery(CallbackServerContext*,
+                                                          const DelegationRequest*) override {
+        return new RejectedStream<DelegationResponse>(
+            Status(grpc::StatusCode::UNIMPLEMENTED, "Leader does not accept delegations"));
+    }
+
+    const std::string& processId() const { return config_.process_id; }
+    AdmissionScheduler& admission() { return admission_; }
+    uint64_t nextAdmissionId() { return ++admission_counter_; }
+
+    // Tenant for fair queuing: the client's own label, else its address
+    static std::string tenantOf(CallbackServerContext* context, const QueryRequest& request) {
+        std::string tenant = request.tenant();
+        if (tenant.empty()) {
+            tenant = context->peer();
+            tenant = tenant.substr(0, tenant.rfind(':'));
+        }
+        return tenant;
+    }
+    int pendingRequests() const { return pending_requests_; }
+    double processLoad(const std::string& process_id) { return status_mgr_.getProcessLoad(process_id); }
+
+    // An execution stopped accepting joiners
+    void forgetSharedQuery(const std::string& key, SharedQuery* shared) {
+        std::lock_guard<std::mutex> lock(shared_queries_mutex_);
+        auto it = shared_queries_.find(key);
+        if (it != shared_queries_.end() && it->second == shared) shared_queries_.erase(it);
+    }
+
+    // Called once per QueryFire when the client stream is done
+    void onQueryDone(bool succeeded) {
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        pending_requests_--;
+        if (succeeded) completed_requests_++;
+        status_mgr_.updateProcessStatus(config_.process_id, pending_requests_, 1, completed_requests_);
+    }
+
+private:
+    ProcessConfig config_;
+    StatusManager status_mgr_;
+    std::map<std::string, std::unique_ptr<ChannelPool>> team_leader_pools_;
+    std::map<std::string, firequery::CompressionPolicy> team_leader_compression_;
+    std::map<std::string, int> team_leader_weight_;
+    std::map<std::string, int> team_leader_ring_bytes_;  // chunk ring asked of each team leader (0 = inline)
+    std::map<std::string, std::string> team_leader_address_;
+    AdmissionScheduler admission_;
+    std::unique_ptr<LoadSampler> load_sampler_;
+    std::atomic<uint64_t> admission_counter_{0};
+    std::map<std::string, SharedQuery*> shared_queries_;          // joinable executions by coalescing key
+    std::mutex shared_queries_mutex_;
+    std::map<std::string, PartitionMapResponse> partition_maps_;  // complete maps by team leader
+    std::set<std::string> partition_fetches_;                     // team leaders being asked
+    std::mutex partitions_mutex_;
+    std::thread rebalancer_;
+    std::mutex rebalance_mutex_;
+    std::condition_variable rebalance_cv_;
+    bool stopping_ = false;
+    std::set<std::pair<std::string, std::string>> unstored_dates_;  // (date, process) a move was refused for
+    std::map<std::string, int> moved_in_round_;                      // date -> rebalance round it last moved in
+    int rebalance_round_ = 0;
+
+    // Rounds a migrated date stays put, so its cost at the new owner is measured before it moves again
+    static constexpr int kMoveCooldownRounds = 3;
+    int request_counter_;
+    std::atomic<int> pending_requests_{0};
+    std::atomic<int> completed_requests_{0};
+    std::mutex status_mutex_;
+
+    // Queries that differ only in who asked them share one execution
+    static std::string coalescingKey(const QueryRequest& request) {
+        QueryRequest normalized = request;
+        normalized.clear_request_id();
+        normalized.clear_tenant();
+        normalized.clear_priority();
+        std::string key;
+        google::protobuf::io::StringOutputStream stream(&key);
+        google::protobuf::io::CodedOutputStream coded(&stream);
+        coded.SetSerializationDeterministic(true);
+        normalized.SerializeToCodedStream(&coded);
+        coded.Trim();
+        return key;
+    }
+
+    // Admission cost of a query: the dates it covers in the partition map, or
+    // its calendar days while the map is unknown
+    double estimateQueryCost(const QueryRequest& request) {
+        std::set<std::string> dates;
+        {
+            std::lock_guard<std::mutex> lock(partitions_mutex_);
+            for (const auto& [team_leader_id, map] : partition_maps_) {
+                for (const auto& entry : map.entries()) {
+                    for (const auto& date : entry.owned_dates()) {
+                        if (date >= request.date_start() && date <= request.date_end()) dates.insert(date);
                     }
                 }
-                r.finished = true;
-                r.finish_status = r.reader->Finish();
-                r.buffer.set_finished();
-                if (!r.finish_status.ok()) {
-                    r.error_occurred = true;
-                    std::cerr << "[Leader] TL " << r.team_leader_id
-                              << " returned error: " << r.finish_status.error_message() << std::endl;
-                }
-            });
+            }
+            if (!partition_maps_.empty()) return static_cast<double>(std::max<size_t>(dates.size(), 1));
         }
 
-        // Leader multiplexer (one-chunk-per-team per scan) + short wait (2 ms)
-        bool all_finished = false;
-        while (!all_finished) {
-            if (context->IsCancelled()) {
-                std::cerr << "[Leader] Client cancelled. Cancelling delegated reads..." << std::endl;
-                cancel_requested.store(true);
-                for (auto& tr : team_readers) if (tr->context) tr->context->TryCancel();
-                break;
+        // Days since 1970-01-01 of a YYYYMMDD date (civil calendar, no time
+        // zone involved), or -1 if it isn't one
+        auto day = [](const std::string& yyyymmdd) -> long {
+            if (yyyymmdd.size() != 8 ||
+                !std::all_of(yyyymmdd.begin(), yyyymmdd.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                return -1;
             }
+            long year = std::stol(yyyymmdd.substr(0, 4));
+            long month = std::stol(yyyymmdd.substr(4, 2));
+            long mday = std::stol(yyyymmdd.substr(6, 2));
+            if (month < 1 || month > 12 || mday < 1 || mday > 31) return -1;
+            if (month <= 2) year--;
+            long era = year / 400;
+            long year_of_era = year - era * 400;
+            long day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + mday - 1;
+            long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+            return era * 146097 + day_of_era - 719468;
+        };
+        long start = day(request.date_start()), end = day(request.date_end());
+        if (start < 0 || end < start) return 1.0;
+        return 1.0 + static_cast<double>(end - start);
+    }
 
-            all_finished = true;
-            bool any_data_this_round = false;
-
-            for (auto& tr_ptr : team_readers) {
-                TeamReader& tr = *tr_ptr;
+    // Ask a team leader for its team's partition map (once it is complete we keep it)
+    void refreshPartitionMap(const std::string& team_leader_id) {
+        auto pool = team_leader_pools_.find(team_leader_id);
+        if (pool == team_leader_pools_.end()) return;
+        {
+            std::lock_guard<std::mutex> lock(partitions_mutex_);
+            if (partition_maps_.count(team_leader_id) || !partition_fetches_.insert(team_leader_id).second) return;
+        }
 
-                // If this team has fully finished and its TEAM_FINISH not logged yet,
-                // log once using relay-side counters (what the client actually saw).
-                if (tr.buffer.is_finished() && !team_finish_logged[tr.team_name]) {
-                    std::string extra = tr.team_name + ",chunks=" + std::to_string(team_chunks_sent[tr.team_name]) +
-                                        ",records=" + std::to_string(team_records_sent[tr.team_name]);
-                    metrics::log_event("TEAM_FINISH", request->request_id(), pending_requests_, 1, -1,
-                                       static_cast<int>(team_records_sent[tr.team_name]), extra);
-                    team_finish_logged[tr.team_name] = true;
+        struct MapCall {
+            ClientContext context;
+            PartitionMapRequest request;
+            PartitionMapResponse response;
+        };
+        auto* call = new MapCall();
+        call->request.set_requesting_process(config_.process_id);
+        call->context.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(5));
+        pool->second->stub()->async()->GetPartitionMap(&call->context, &call->request, &call->response,
+            [this, call, team_leader_id](Status status) {
+                std::lock_guard<std::mutex> lock(partitions_mutex_);
+                partition_fetches_.erase(team_leader_id);
+                if (status.ok() && call->response.complete()) {
+                    std::cout << "[Leader] Partition map from " << team_leader_id << ": "
+                              << call->response.entries_size() << " processes" << std::endl;
+                    partition_maps_[team_leader_id] = std::move(call->response);
                 }
+                delete call;
+            });
+    }
 
-                if (tr.buffer.is_finished()) {
-                    continue; // nothing left for this team
+    // Teams whose partitions intersect the query, each with the dates it should
+    // serve (one holder per date, least loaded first). Until every team's map is
+    // known, all teams are asked with no target dates and serve their own.
+    std::map<std::string, std::vector<std::string>> selectTeamsForQuery(const QueryRequest* request) {
+        std::map<std::string, std::vector<std::string>> teams;
+        std::map<std::string, PartitionMapResponse> maps;
+        {
+            std::lock_guard<std::mutex> lock(partitions_mutex_);
+            maps = partition_maps_;
+        }
+
+        bool complete = true;
+        for (const auto& edge : config_.edges) {
+            if (edge.relationship != "team_leader") continue;
+            if (!maps.count(edge.to)) {
+                complete = false;
+                refreshPartitionMap(edge.to);
+            }
+        }
+        if (!complete) {
+            for (const auto& edge : config_.edges) {
+                if (edge.relationship == "team_leader") teams[edge.team];
+            }
+            return teams;
+        }
+
+        auto in_range = [request](const std::string& date) {
+            return date >= request->date_start() && date <= request->date_end();
+        };
+        std::map<std::string, std::string> team_of_process;
+        ReplicaPlanner planner([this](const std::string& process_id) {
+            return status_mgr_.getProcessLoad(process_id);
+        });
+        for (const auto& edge : config_.edges) {
+            if (edge.relationship != "team_leader") continue;
+            for (const auto& entry : maps[edge.to].entries()) {
+                team_of_process[entry.process_id()] = edge.team;
+                for (const auto& date : entry.owned_dates()) {
+                    if (in_range(date)) planner.addHolder(date, entry.process_id());
                 }
+            }
+        }
+        for (const auto& edge : config_.edges) {
+            if (edge.relationship != "team_leader") continue;
+            for (const auto& entry : maps[edge.to].entries()) {
+                for (const auto& date : entry.replica_dates()) {
+                    if (in_range(date)) planner.addHolder(date, entry.process_id());
+                }
+            }
+        }
 
-                all_finished = false;
-
-                // Pop at most ONE chunk this scan from this team
-                DelegationResponse delegation_resp;
-                if (tr.buffer.wait_pop_for(delegation_resp, std::chrono::milliseconds(2))) {
-                    any_data_this_round = true;
-
-                    QueryResponse query_resp;
-                    query_resp.set_request_id(request->request_id());
-                    query_resp.set_chunk_number(total_chunk_number++);
-                    query_resp.set_total_chunks(-1);
-                    query_resp.set_is_final(false);
-                    query_resp.set_source_process(delegation_resp.responding_process());
-
-                    // Copy records
-                    int sent_this_chunk = 0;
-                    for (const auto& record : delegation_resp.records()) {
-                        auto* out = query_resp.add_records();
-                        out->CopyFrom(record);
-                        ++sent_this_chunk;
-                    }
-                    total_records += sent_this_chunk;
-
-                    // Stream to client
-                    if (!writer->Write(query_resp)) {
-                        std::cerr << "[Leader] Client disconnected during streaming\n";
-                        metrics::log_event("CLIENT_DISCONNECT", request->request_id(), pending_requests_, 1,
-                                           query_resp.chunk_number(), query_resp.records_size(),
-                                           "client disconnected during streaming");
-                        cancel_requested.store(true);
-                        for (auto& tr2 : team_readers) if (tr2->context) tr2->context->TryCancel();
-                        for (auto& th : reader_threads) if (th.joinable()) th.join();
-                        return Status::CANCELLED;
-                    }
+        for (auto& [process_id, dates] : planner.assign()) {
+            auto& team_dates = teams[team_of_process[process_id]];
+            team_dates.insert(team_dates.end(), dates.begin(), dates.end());
+        }
+        for (auto& [team_name, dates] : teams) {
+            std::sort(dates.begin(), dates.end());
+        }
+        return teams;
+    }
 
-                    // Update per-team counters and metrics
-                    team_chunks_sent[tr.team_name] += 1;
-                    team_records_sent[tr.team_name] += sent_this_chunk;
+    // Every repartition interval, move dates off the busiest processes until
+    // their scan load is within the target imbalance (see PartitionBalancer)
+    void rebalanceLoop() {
+        auto interval = std::chrono::seconds(config_.repartition_config.interval_s);
+        std::unique_lock<std::mutex> lock(rebalance_mutex_);
+        while (!rebalance_cv_.wait_for(lock, interval, [this]() { return stopping_; })) {
+            lock.unlock();
+            rebalanceOnce();
+            lock.lock();
+        }
+    }
 
-                    metrics::log_event("CHUNK_RELAY", request->request_id(), pending_requests_, 1,
-                                       query_resp.chunk_number(), query_resp.records_size(),
-                                       delegation_resp.responding_process());
+    void rebalanceOnce() {
+        // Fresh maps (with scan costs) of every team; they also replace the routing maps
+        std::map<std::string, PartitionMapResponse> maps;
+        for (const auto& edge : config_.edges) {
+            if (edge.relationship != "team_leader") continue;
+            if (!fetchPartitionMap(edge.to, &maps[edge.to])) {
+                metrics::log_event("REPARTITION_SKIP", "", pending_requests_, 1, -1, -1,
+                                   "no complete map from " + edge.to);
+                return;
+            }
+        }
 
-                    std::cout << "  Sent chunk " << query_resp.chunk_number()
-                              << " with " << query_resp.records_size() << " records from "
-                              << query_resp.source_process()
-                              << " (team: " << tr.team_name << ")\n";
+        PartitionBalancer balancer;
+        std::map<std::string, std::string> team_leader_of;
+        for (const auto& [team_leader_id, map] : maps) {
+            for (const auto& entry : map.entries()) {
+                team_leader_of[entry.process_id()] = team_leader_id;
+                int64_t bytes = 0, scan_us = 0;
+                for (const auto& cost : entry.date_costs()) {
+                    balancer.addDateCost(cost.date(), cost.bytes());
+                    bytes += cost.bytes();
+                    scan_us += cost.scan_us();
                 }
-                // IMPORTANT: do NOT pop another chunk from this same team in this scan (enforces 1 chunk/team/scan)
+                balancer.addProcess(entry.process_id(),
+                                    std::vector<std::string>(entry.owned_dates().begin(), entry.owned_dates().end()),
+                                    bytes, scan_us);
+            }
+        }
+        for (const auto& [date, process_id] : unstored_dates_) balancer.exclude(date, process_id);
+        rebalance_round_++;
+        for (auto it = moved_in_round_.begin(); it != moved_in_round_.end();) {
+            if (rebalance_round_ - it->second > kMoveCooldownRounds) {
+                it = moved_in_round_.erase(it);
+            } else {
+                balancer.pin(it->first);
+                ++it;
             }
+        }
 
-            if (!any_data_this_round && !all_finished) {
-                // Nothing ready anywhere this round: log and brief sleep
-                metrics::log_event("NO_DATA_ROUND", request->request_id(), pending_requests_, 1, -1, -1, "");
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        auto plan = balancer.plan(config_.repartition_config.max_imbalance_pct / 100.0,
+                                  config_.repartition_config.max_moves);
+        char imbalance[64];
+        std::snprintf(imbalance, sizeof(imbalance), "imbalance=%.2f->%.2f", plan.imbalance_before, plan.imbalance_after);
+        metrics::log_event("REPARTITION_PLAN", "", pending_requests_, 1, -1, static_cast<int>(plan.moves.size()),
+                           imbalance);
+        if (plan.moves.empty()) return;
+        std::cout << "[Leader] Repartitioning (" << imbalance << "): " << plan.moves.size() << " moves" << std::endl;
+
+        std::set<std::string> touched;
+        for (const auto& move : plan.moves) {
+            if (migrateDate(move, team_leader_of)) {
+                moved_in_round_[move.date] = rebalance_round_;
+                touched.insert(team_leader_of[move.from]);
+                touched.insert(team_leader_of[move.to]);
             }
         }
+        for (const auto& team_leader_id : touched) {
+            PartitionMapResponse map;
+            fetchPartitionMap(team_leader_id, &map);
+        }
+    }
+
+    // Hand one date's ownership from move.from to move.to. The new owner first
+    // takes it as a replica (and refuses if it does not store the date); then
+    // the old owner demotes its copy to a replica and the new one promotes
+    // its copy to owned. A query routed with either map still finds a holder,
+    // and the old owner keeps serving the date only when targeted.
+    bool migrateDate(const PartitionBalancer::Move& move, std::map<std::string, std::string>& team_leader_of) {
+        auto update = [&](const std::string& process_id, std::vector<std::string> add_owned,
+                          std::vector<std::string> remove_owned, std::vector<std::string> add_replica,
+                          std::vector<std::string> remove_replica, std::string* refusal) {
+            PartitionUpdate request;
+            request.set_requesting_process(config_.process_id);
+            request.set_process_id(process_id);
+            for (auto& date : add_owned) request.add_add_owned(std::move(date));
+            for (auto& date : remove_owned) request.add_remove_owned(std::move(date));
+            for (auto& date : add_replica) request.add_add_replica(std::move(date));
+            for (auto& date : remove_replica) request.add_remove_replica(std::move(date));
+            return sendPartitionUpdate(team_leader_of[process_id], request, refusal);
+        };
+        const std::string& date = move.date;
+        std::string what = date + ":" + move.from + "->" + move.to;
+        std::string refusal;
+
+        if (!update(move.to, {}, {}, {date}, {}, &refusal)) {
+            if (!refusal.empty()) unstored_dates_.insert({date, move.to});
+            metrics::log_event("REPARTITION_FAILED", "", pending_requests_, 1, -1, -1, what + " " + refusal);
+            return false;
+        }
+        if (!update(move.from, {}, {date}, {date}, {}, &refusal)) {
+            update(move.to, {}, {}, {}, {date}, nullptr);
+            metrics::log_event("REPARTITION_FAILED", "", pending_requests_, 1, -1, -1, what + " " + refusal);
+            return false;
+        }
+        if (!update(move.to, {date}, {}, {}, {date}, &refusal)) {
+            update(move.from, {date}, {}, {}, {date}, nullptr);
+            update(move.to, {}, {}, {}, {date}, nullptr);
+            metrics::log_event("REPARTITION_FAILED", "", pending_requests_, 1, -1, -1, what + " " + refusal);
+            return false;
+        }
 
-        // Join readers
-        for (auto& th : reader_threads) {
-            if (th.joinable()) th.join();
+        metrics::log_event("REPARTITION_MOVE", "", pending_requests_, 1, -1, -1, what);
+        std::cout << "[Leader] Moved date " << what << std::endl;
+        return true;
+    }
+
+    // Send an update to a process through its team leader. Returns true if it
+    // was applied; a refusal by the process (as opposed to an RPC error) is put in refusal.
+    bool sendPartitionUpdate(const std::string& team_leader_id, const PartitionUpdate& request, std::string* refusal) {
+        auto pool = team_leader_pools_.find(team_leader_id);
+        if (pool == team_leader_pools_.end()) return false;
+        PartitionUpdateAck ack;
+        ClientContext client_ctx;
+        client_ctx.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(5));
+        Status status = pool->second->stub()->UpdatePartition(&client_ctx, request, &ack);
+        if (!status.ok()) {
+            std::cerr << "[Leader] Partition update for " << request.process_id() << " failed: "
+                      << status.error_message() << std::endl;
+            return false;
         }
+        if (!ack.applied() && refusal) *refusal = ack.message();
+        return ack.applied();
+    }
 
-        // Log TEAM_FINISH for any teams not yet logged (edge case: finished after loop exit)
-        for (auto& tr_ptr : team_readers) {
-            auto& tr = *tr_ptr;
-            if (!team_finish_logged[tr.team_name]) {
-                std::string extra = tr.team_name + ",chunks=" + std::to_string(team_chunks_sent[tr.team_name]) +
-                                    ",records=" + std::to_string(team_records_sent[tr.team_name]);
-                metrics::log_event("TEAM_FINISH", request->request_id(), pending_requests_, 1, -1,
-                                   static_cast<int>(team_records_sent[tr.team_name]), extra);
-                team_finish_logged[tr.team_name] = true;
+    // Synchronously fetch a team's partition map; a complete one replaces the cached map
+    bool fetchPartitionMap(const std::string& team_leader_id, PartitionMapResponse* map) {
+        auto pool = team_leader_pools_.find(team_leader_id);
+        if (pool == team_leader_pools_.end()) return false;
+        PartitionMapRequest request;
+        request.set_requesting_process(config_.process_id);
+        ClientContext client_ctx;
+        client_ctx.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(5));
+        Status status = pool->second->stub()->GetPartitionMap(&client_ctx, request, map);
+        if (!status.ok() || !map->complete()) return false;
+        std::lock_guard<std::mutex> lock(partitions_mutex_);
+        partition_maps_[team_leader_id] = *map;
+        return true;
+    }
+
+    std::string getTeamLeader(const std::string& team_name) {
+        for (const auto& edge : config_.edges) {
+            if (edge.team == team_name && edge.relationship == "team_leader") {
+                return edge.to;
             }
         }
+        return "";
+    }
+};
 
-        // Final chunk
-        QueryResponse final_resp;
-        final_resp.set_request_id(request->request_id());
-        final_resp.set_chunk_number(total_chunk_number);
-        final_resp.set_total_chunks(total_chunk_number + 1);
-        final_resp.set_is_final(true);
-        final_resp.set_total_records(total_records);
-        final_resp.set_source_process(config_.process_id);
-        if (!writer->Write(final_resp)) {
-            std::cerr << "[Leader] Client disconnected while sending final\n";
-            metrics::log_event("CLIENT_DISCONNECT_FINAL", request->request_id(), pending_requests_, 1,
-                               final_resp.chunk_number(), final_resp.total_records(),
-                               "client disconnected on final chunk");
-            return Status::CANCELLED;
+// ==========================
+// RoutingPlanReactor
+// ==========================
+void RoutingPlanReactor::admit(const std::string& tenant, int weight, double cost) {
+    admission_id_ = service_->nextAdmissionId();
+    auto decision = service_->admission().submit(admission_id_, tenant, weight, cost,
+        [this](const AdmissionScheduler::Admission& admission) { start(admission); });
+
+    if (decision == AdmissionScheduler::Decision::kQueued) {
+        int depth = service_->admission().queued();
+        metrics::log_event("ADMISSION_QUEUED", request_.request_id(), service_->pendingRequests(), 1, -1, depth,
+                           "tenant=" + tenant + ",cost=" + std::to_string(static_cast<int>(cost)) + ",direct");
+        std::cout << "  Routing plan queued by admission control (tenant " << tenant << ", "
+                  << depth << " waiting)" << std::endl;
+    } else if (decision == AdmissionScheduler::Decision::kRejected) {
+        metrics::log_event("ADMISSION_REJECTED", request_.request_id(), service_->pendingRequests(), 1, -1, 1,
+                           "tenant=" + tenant + ",direct");
+        std::cerr << "[Leader] Rejecting " << request_.request_id() << ": admission queue full" << std::endl;
+        Finish(Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Leader is overloaded, retry later"));
+    }
+}
+
+void RoutingPlanReactor::start(const AdmissionScheduler::Admission& admission) {
+    interactive_slot_ = admission.interactive;
+    admitted_ = true;
+    metrics::log_event("QUEUE_WAIT", request_.request_id(), service_->pendingRequests(), 1, -1,
+                       static_cast<int>(admission.queued.count()),
+                       std::string("started,direct") + (admission.interactive ? ",interactive" : ""));
+
+    remaining_ = static_cast<int>(calls_.size());
+    if (calls_.empty()) {
+        sendPlan();
+        return;
+    }
+    for (auto& call_ptr : calls_) {
+        MapCall* call = call_ptr.get();
+        call->request.set_requesting_process(service_->processId());
+        call->context.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(5));
+        call->channel.stub()->async()->GetPartitionMap(&call->context, &call->request, &call->response,
+            [this, call](Status status) {
+                call->status = std::move(status);
+                if (--remaining_ == 0) sendPlan();
+            });
+    }
+}
+
+// Give every date in the query range to one of its holders (owner or
+// replica) with ReplicaPlanner: the holder whose sampled load score
+// (processLoad, weighted by kLoadWeight) plus the dates this plan has already
+// given it is lowest; ties go to the owner
+void RoutingPlanReactor::sendPlan() {
+    RoutingPlan* plan = out_.mutable_routing_plan();
+    std::map<std::string, std::string> address_of_process;
+    std::vector<const firequery::PartitionEntry*> entries;
+
+    for (auto& call : calls_) {
+        if (!call->status.ok()) {
+            std::cerr << "[Leader] Partition map from " << call->team_leader_id
+                      << " unavailable: " << call->status.error_message() << std::endl;
+            continue;
         }
+        for (const auto& entry : call->response.entries()) {
+            address_of_process.emplace(entry.process_id(),
+                                       entry.address().empty() ? call->address : entry.address());
+            entries.push_back(&entry);
+        }
+    }
 
-        metrics::log_event("FINAL_CHUNK", request->request_id(), pending_requests_, 1,
-                           final_resp.chunk_number(), final_resp.total_records(), "final from leader");
-        metrics::log_event("FINISH", request->request_id(), pending_requests_, 1, -1, total_records,
-                           "query complete at leader");
+    // Each date goes to its least-loaded holder; owners are added before replicas
+    auto in_range = [this](const std::string& date) {
+        return date >= request_.date_start() && date <= request_.date_end();
+    };
+    ReplicaPlanner planner([this](const std::string& process_id) {
+        return service_->processLoad(process_id);
+    });
+    for (const auto* entry : entries) {
+        for (const auto& date : entry->owned_dates()) {
+            if (in_range(date)) planner.addHolder(date, entry->process_id());
+        }
+    }
+    for (const auto* entry : entries) {
+        for (const auto& date : entry->replica_dates()) {
+            if (in_range(date)) planner.addHolder(date, entry->process_id());
+        }
+    }
+
+    size_t assigned = 0;
+    for (auto& [process_id, dates] : planner.assign()) {
+        auto* route = plan->add_routes();
+        route->set_process_id(process_id);
+        route->set_address(address_of_process[process_id]);
+        for (const auto& date : dates) route->add_dates(date);
+        assigned += dates.size();
+    }
+
+    out_.set_request_id(request_.request_id());
+    out_.set_chunk_number(0);
+    out_.set_total_chunks(1);
+    out_.set_is_final(true);
+    out_.set_total_records(-1);
+    out_.set_source_process(service_->processId());
+
+    metrics::log_event("ROUTING_PLAN", request_.request_id(), service_->pendingRequests(), 1, -1, -1,
+                       "routes=" + std::to_string(plan->routes_size()) +
+                       ",dates=" + std::to_string(assigned));
+    std::cout << "[Leader] Routing plan for " << request_.request_id() << ": "
+              << plan->routes_size() << " routes, " << assigned << " dates" << std::endl;
+
+    StartWrite(&out_);
+}
+
+void RoutingPlanReactor::OnWriteDone(bool ok) {
+    if (!ok) {
+        metrics::log_event("CLIENT_DISCONNECT_FINAL", request_.request_id(), service_->pendingRequests(), 1,
+                           0, -1, "client disconnected before routing plan");
+        Finish(Status::CANCELLED);
+        return;
+    }
+    metrics::log_event("FINISH", request_.request_id(), service_->pendingRequests(), 1, -1, -1,
+                       "routing plan sent");
+    succeeded_ = true;
+    Finish(Status::OK);
+}
+
+// Still queued: leave the queue and finish here. Otherwise the map calls
+// fail fast (or are cancelled as they start) and the plan write fails.
+void RoutingPlanReactor::OnCancel() {
+    if (service_->admission().cancel(admission_id_)) {
+        Finish(Status::CANCELLED);
+        return;
+    }
+    for (auto& call : calls_) call->context.TryCancel();
+}
+
+void RoutingPlanReactor::OnDone() {
+    CancellationRegistry::instance().remove(cancel_handle_);
+    if (admitted_) service_->admission().finished(interactive_slot_);
+    service_->onQueryDone(succeeded_);
+    delete this;
+}
+
+// ==========================
+// TeamStream reactions
+// ==========================
+void TeamStream::OnReadDone(bool ok) {
+    if (!ok) {
+        RemoveHold();  // end of stream (or cancelled); OnDone follows
+        return;
+    }
+    if (!ring_.resolve(incoming_)) {
+        std::cerr << "[Leader] Bad chunk ring reference from " << team_leader_id << std::endl;
+        context.TryCancel();
+        StartRead(&incoming_);  // fails, ending the stream
+        return;
+    }
+    owner_->onTeamChunk(this, std::move(incoming_));
+}
+
+void TeamStream::OnDone(const Status& status) {
+    owner_->onTeamDone(this, status);
+}
+
+// ==========================
+// SharedQuery
+// ==========================
+SharedQuery::~SharedQuery() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Log TEAM_FINISH for any teams not yet logged (e.g. every client went away)
+        for (auto& team : teams_) logTeamFinishLocked(*team);
+    }
+    if (admitted_) service_->admission().finished(interactive_slot_);
+}
+
+bool SharedQuery::attach(QueryFireReactor* client) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closing_ || (!joinable_ && !cursors_.empty())) return false;
+    cursors_[client] = log_base_;
+    outstanding_++;
+    return true;
+}
+
+void SharedQuery::detach(QueryFireReactor* client) {
+    Effects fx;
+    bool cancel_teams = false, cancel_queued = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cursors_.erase(client);
+        if (cursors_.empty()) {
+            closing_ = true;
+            fx.forget = joinable_;
+            joinable_ = false;
+            cancel_teams = started_;
+            cancel_queued = queued_;
+            for (auto& team : teams_) team->buffer.clear();
+        } else {
+            pumpLocked(fx);  // it may have been the slowest
+            wakeLocked(fx, nullptr);
+        }
+    }
+    run(fx);
+    if (cancel_teams) cancelTeams();
+    if (cancel_queued && service_->admission().cancel(admission_id_)) {
+        release();  // the queue's hold; start() will not run
+    }
+    release();  // the client's
+}
 
-        std::cout << "[Leader] Query " << request->request_id() << " complete. "
-                  << "Sent " << (total_chunk_number + 1) << " chunks, "
-                  << total_records << " total records\n";
+AdmissionScheduler::Decision SharedQuery::admit(const std::string& tenant, int weight, double cost) {
+    admission_id_ = service_->nextAdmissionId();
+    outstanding_++;  // held while queued, released by start() or when leaving the queue
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_ = true;
+    }
 
+    auto decision = service_->admission().submit(admission_id_, tenant, weight, cost,
+        [this](const AdmissionScheduler::Admission& admission) { start(admission); });
+
+    if (decision == AdmissionScheduler::Decision::kQueued) {
+        int depth = service_->admission().queued();
+        metrics::log_event("ADMISSION_QUEUED", requestId(), service_->pendingRequests(), 1, -1, depth,
+                           "tenant=" + tenant + ",cost=" + std::to_string(static_cast<int>(cost)));
+        std::cout << "  Queued by admission control (tenant " << tenant << ", cost " << cost
+                  << ", " << depth << " waiting)" << std::endl;
+    } else if (decision == AdmissionScheduler::Decision::kRejected) {
+        Effects fx;
+        std::vector<QueryFireReactor*> clients;
         {
-            std::lock_guard<std::mutex> lock(status_mutex_);
-            pending_requests_--;
-            completed_requests_++;
-            status_mgr_.updateProcessStatus(config_.process_id, pending_requests_, 1, completed_requests_);
+            std::lock_guard<std::mutex> lock(mutex_);
+            queued_ = false;
+            closing_ = true;
+            fx.forget = joinable_;
+            joinable_ = false;
+            for (auto& [client, cursor] : cursors_) {
+                client->hold();
+                clients.push_back(client);
+            }
+        }
+        metrics::log_event("ADMISSION_REJECTED", requestId(), service_->pendingRequests(), 1, -1,
+                           static_cast<int>(clients.size()), "tenant=" + tenant);
+        std::cerr << "[Leader] Rejecting " << requestId() << ": admission queue full" << std::endl;
+        run(fx);
+        for (auto* client : clients) {
+            client->reject(Status(grpc::StatusCode::RESOURCE_EXHAUSTED, "Leader is overloaded, retry later"));
+            client->release();
         }
+        release();
+    }
+    return decision;
+}
 
-        return Status::OK;
+void SharedQuery::start(const AdmissionScheduler::Admission& admission) {
+    bool cancelled;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_ = false;
+        cancelled = closing_;
+        admitted_ = !cancelled;
+        started_ = !cancelled;
+        interactive_slot_ = admission.interactive;
     }
+    metrics::log_event("QUEUE_WAIT", requestId(), service_->pendingRequests(), 1, -1,
+                       static_cast<int>(admission.queued.count()),
+                       std::string(cancelled ? "cancelled" : "started") + (admission.interactive ? ",interactive" : ""));
+
+    if (cancelled) {
+        // Every client went away while we were being dispatched: give the slot back
+        service_->admission().finished(admission.interactive);
+    } else {
+        outstanding_ += static_cast<int>(teams_.size());
+        for (auto& team : teams_) team->start();
+        Effects fx;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeLocked(fx, nullptr);  // no teams: the final can go out right away
+        }
+        run(fx);
+    }
+    release();
+}
 
-    Status HealthCheck(ServerContext*,
-                       const HealthRequest*,
-                       HealthResponse* response) override {
-        response->set_responding_process(config_.process_id);
-        response->set_is_healthy(true);
-        response->set_pending_requests(pending_requests_);
-        response->set_active_workers(1);
-        return Status::OK;
+SharedQuery::Next SharedQuery::next(QueryFireReactor* client) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Next next;
+    auto it = cursors_.find(client);
+    if (it == cursors_.end()) return next;
+    size_t cursor = it->second;
+
+    if (cursor < logEndLocked()) {
+        next.chunk = log_[cursor - log_base_];
+        // The slowest client, alone at the front of a log nobody can join any
+        // more, takes the entry out of the log instead of copying it
+        bool alone = std::none_of(cursors_.begin(), cursors_.end(), [&](const auto& other) {
+            return other.first != client && other.second == cursor;
+        });
+        if (!joinable_ && cursor == log_base_ && alone) {
+            log_.pop_front();
+            log_base_++;
+            next.owned = true;
+        }
+    } else if (completeLocked()) {
+        next.final = true;
+        next.chunk_count = static_cast<int>(logEndLocked());
+        next.total_records = total_records_;
     }
+    return next;
+}
 
-    Status CancelQuery(ServerContext*,
-                       const CancelRequest* request,
-                       CancelResponse* response) override {
-        std::cout << "[Leader] Received cancel for " << request->request_id() << std::endl;
-        response->set_request_id(request->request_id());
-        response->set_cancelled(true);
-        response->set_message("Query cancellation acknowledged");
-        return Status::OK;
+void SharedQuery::advance(QueryFireReactor* client) {
+    Effects fx;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cursors_.find(client);
+        if (it == cursors_.end()) return;
+        it->second++;
+        pumpLocked(fx);
+        wakeLocked(fx, client);
     }
+    run(fx);
+}
 
-    Status DelegateQuery(ServerContext*,
-                         const DelegationRequest*,
-                         ServerWriter<DelegationResponse>*) override {
-        return Status(grpc::StatusCode::UNIMPLEMENTED, "Leader does not accept delegations");
+void SharedQuery::onTeamChunk(TeamStream* team, DelegationResponse&& chunk) {
+    Effects fx;
+    bool read_more = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Once closing the team call is cancelled, so keep reading to drain it
+        if (!closing_) team->buffer.push_back(std::move(chunk));
+        read_more = closing_ || team->buffer.size() < kTeamBufferChunks;
+        team->read_paused = !read_more;
+        pumpLocked(fx);
+        wakeLocked(fx, nullptr);
     }
+    if (read_more) team->resumeRead();
+    run(fx);
+}
 
-private:
-    ProcessConfig config_;
-    StatusManager status_mgr_;
-    std::map<std::string, std::unique_ptr<FireQueryService::Stub>> team_leader_stubs_;
-    int request_counter_;
-    int pending_requests_ = 0;
-    int completed_requests_ = 0;
-    std::mutex status_mutex_;
+void SharedQuery::onTeamDone(TeamStream* team, const Status& status) {
+    if (!status.ok() && status.error_code() != grpc::StatusCode::CANCELLED) {
+        std::cerr << "[Leader] TL " << team->team_leader_id
+                  << " returned error: " << status.error_message() << std::endl;
+    }
+    Effects fx;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        team->done = true;
+        team->read_paused = false;
+        pumpLocked(fx);
+        wakeLocked(fx, nullptr);
+    }
+    run(fx);
+    release();
+}
+
+size_t SharedQuery::slowestLocked() const {
+    size_t slowest = logEndLocked();
+    for (const auto& [client, cursor] : cursors_) slowest = std::min(slowest, cursor);
+    return slowest;
+}
+
+// Every team finished and everything it sent is in the log
+bool SharedQuery::completeLocked() const {
+    if (!started_) return false;
+    return std::all_of(teams_.begin(), teams_.end(), [](const auto& team) {
+        return team->done && team->buffer.empty();
+    });
+}
+
+// Move team chunks into the log, weighted round-robin, until the slowest
+// client is kTeamBufferChunks behind. Team reads are resumed and credit is
+// returned for every chunk taken from a team.
+void SharedQuery::pumpLocked(Effects& fx) {
+    if (closing_) return;
+    while (logEndLocked() - slowestLocked() < kTeamBufferChunks) {
+        // The current team keeps its turn for up to `weight` chunks; teams
+        // with nothing buffered are skipped
+        TeamStream* team = nullptr;
+        for (size_t n = 0; n < teams_.size() && !team; ++n) {
+            size_t idx = (next_team_ + n) % teams_.size();
+            if (teams_[idx]->buffer.empty()) continue;
+            team = teams_[idx].get();
+            if (idx != next_team_) burst_ = 0;
+            if (++burst_ >= team->weight) {
+                next_team_ = (idx + 1) % teams_.size();
+                burst_ = 0;
+            } else {
+                next_team_ = idx;
+            }
+        }
+        if (!team) break;
+
+        DelegationResponse chunk = std::move(team->buffer.front());
+        team->buffer.pop_front();
+        if (team->read_paused && !team->done) {
+            team->read_paused = false;
+            fx.resume.push_back(team);
+        }
+        if (request_window_ > 0 && !team->done) {
+            if (int grant = team->credit.consumed()) fx.credit.emplace_back(team, grant);
+        }
 
-    std::vector<std::string> selectTeamsForQuery(const QueryRequest*) {
-        // Query both teams to demonstrate parallelism
-        return {"green", "pink"};
+        // Move the payload into the client envelope: batches are opaque bytes
+        // and row records are swapped, so nothing is copied per record
+        auto out = std::make_shared<QueryResponse>();
+        out->set_chunk_number(static_cast<int>(logEndLocked()));
+        out->set_total_chunks(-1);
+        out->set_is_final(false);
+        out->set_source_process(chunk.responding_process());
+        int records = chunkRecordCount(chunk);
+        out->set_record_count(records);
+        if (!chunk.batch_payload().empty()) {
+            out->set_batch_payload(std::move(*chunk.mutable_batch_payload()));
+        } else {
+            out->mutable_records()->Swap(chunk.mutable_records());
+        }
+        log_.push_back(std::move(out));
+        total_records_ += records;
+        team->chunks_sent += 1;
+        team->records_sent += records;
     }
 
-    std::string getTeamLeader(const std::string& team_name) {
-        for (const auto& edge : config_.edges) {
-            if (edge.team == team_name && edge.relationship == "team_leader") {
-                return edge.to;
+    for (auto& team : teams_) {
+        if (team->done && team->buffer.empty()) logTeamFinishLocked(*team);
+    }
+
+    if (joinable_ && logEndLocked() > replay_chunks_) {
+        joinable_ = false;
+        fx.forget = true;
+    }
+    if (!joinable_) {
+        size_t slowest = slowestLocked();
+        while (!log_.empty() && log_base_ < slowest) {
+            log_.pop_front();
+            log_base_++;
+        }
+    }
+}
+
+void SharedQuery::wakeLocked(Effects& fx, QueryFireReactor* except) {
+    for (auto& [client, cursor] : cursors_) {
+        if (client == except) continue;
+        client->hold();
+        fx.wake.push_back(client);
+    }
+}
+
+void SharedQuery::run(Effects& fx) {
+    if (fx.forget) service_->forgetSharedQuery(key_, this);
+    for (auto* team : fx.resume) team->resumeRead();
+    for (auto& [team, grant] : fx.credit) team->returnCredit(grant);
+    for (auto* client : fx.wake) {
+        client->maybeWrite();
+        client->release();
+    }
+}
+
+void SharedQuery::cancelTeams() {
+    std::vector<TeamStream*> paused;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& team : teams_) {
+            if (team->read_paused && !team->done) {
+                team->read_paused = false;
+                paused.push_back(team.get());
             }
         }
-        return "";
     }
-};
+    for (auto& team : teams_) team->context.TryCancel();
+    // A paused stream has no read pending; restart it so it observes the
+    // cancellation, drops its hold and reaches OnDone
+    for (auto* team : paused) team->resumeRead();
+}
+
+// Log TEAM_FINISH once using relay-side counters (what was put in the log)
+void SharedQuery::logTeamFinishLocked(TeamStream& team) {
+    if (team.finish_logged) return;
+    std::string extra = team.team_name + ",chunks=" + std::to_string(team.chunks_sent) +
+                        ",records=" + std::to_string(team.records_sent);
+    metrics::log_event("TEAM_FINISH", requestId(), service_->pendingRequests(), 1, -1,
+                       static_cast<int>(team.records_sent), extra);
+    team.finish_logged = true;
+}
+
+// ==========================
+// QueryFireReactor
+// ==========================
+bool QueryFireReactor::attachTo(SharedQuery* upstream) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        upstream_ = upstream;
+        attached_ = true;
+    }
+    if (upstream->attach(this)) return true;
+    std::lock_guard<std::mutex> lock(mutex_);
+    upstream_ = nullptr;
+    attached_ = false;
+    return false;
+}
+
+// Take the next entry from the execution (or the final chunk) and start
+// writing it. gRPC operations are started outside the mutex.
+void QueryFireReactor::maybeWrite() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (write_in_flight_ || final_started_ || finished_ || !attached_) return;
+
+        SharedQuery::Next next = upstream_->next(this);
+        if (next.chunk) {
+            // Entries are shared with other clients unless handed over
+            if (next.owned) {
+                out_.Swap(next.chunk.get());
+            } else {
+                out_.CopyFrom(*next.chunk);
+            }
+            out_.set_request_id(request_.request_id());
+            out_records_ = out_.record_count();
+            total_records_ += out_records_;
+        } else if (next.final) {
+            out_.Clear();
+            out_.set_request_id(request_.request_id());
+            out_.set_chunk_number(next.chunk_count);
+            out_.set_total_chunks(next.chunk_count + 1);
+            out_.set_is_final(true);
+            out_.set_total_records(next.total_records);
+            out_.set_source_process(service_->processId());
+            out_records_ = 0;
+            final_started_ = true;
+        } else {
+            return;
+        }
+        write_in_flight_ = true;
+    }
+    StartWrite(&out_);
+}
+
+void QueryFireReactor::OnWriteDone(bool ok) {
+    const std::string& request_id = request_.request_id();
+
+    if (!ok) {
+        if (final_started_) {
+            std::cerr << "[Leader] Client disconnected while sending final\n";
+            metrics::log_event("CLIENT_DISCONNECT_FINAL", request_id, service_->pendingRequests(), 1,
+                               out_.chunk_number(), out_.total_records(),
+                               "client disconnected on final chunk");
+        } else {
+            std::cerr << "[Leader] Client disconnected during streaming\n";
+            metrics::log_event("CLIENT_DISCONNECT", request_id, service_->pendingRequests(), 1,
+                               out_.chunk_number(), out_records_,
+                               "client disconnected during streaming");
+        }
+        writeFinished();
+        finishOnce(Status::CANCELLED);
+        detach();
+        return;
+    }
+
+    if (final_started_) {
+        metrics::log_event("FINAL_CHUNK", request_id, service_->pendingRequests(), 1,
+                           out_.chunk_number(), out_.total_records(), "final from leader");
+        metrics::log_event("FINISH", request_id, service_->pendingRequests(), 1, -1, total_records_,
+                           "query complete at leader");
+
+        std::cout << "[Leader] Query " << request_id << " complete. "
+                  << "Sent " << (out_.chunk_number() + 1) << " chunks, "
+                  << total_records_ << " total records\n";
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            succeeded_ = true;
+        }
+        writeFinished();
+        finishOnce(Status::OK);
+        return;
+    }
+
+    metrics::log_event("CHUNK_RELAY", request_id, service_->pendingRequests(), 1,
+                       out_.chunk_number(), out_records_, out_.source_process());
+
+    std::cout << "  Sent chunk " << out_.chunk_number()
+              << " with " << out_records_ << " records from "
+              << out_.source_process() << "\n";
+
+    upstream_->advance(this);
+    writeFinished();
+    maybeWrite();
+}
+
+void QueryFireReactor::OnCancel() {
+    std::cerr << "[Leader] Client cancelled " << request_.request_id() << std::endl;
+    finishOnce(Status::CANCELLED);
+    detach();
+}
+
+void QueryFireReactor::OnDone() {
+    CancellationRegistry::instance().remove(cancel_handle_);
+    detach();
+
+    bool succeeded;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        succeeded = succeeded_;
+    }
+    service_->onQueryDone(succeeded);
+    release();
+}
+
+void QueryFireReactor::detach() {
+    SharedQuery* upstream;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!attached_) return;
+        attached_ = false;
+        upstream = upstream_;
+    }
+    upstream->detach(this);
+}
+
+// The write in flight has completed; run a Finish that was waiting for it
+void QueryFireReactor::writeFinished() {
+    Status status;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        write_in_flight_ = false;
+        if (!finish_deferred_) return;
+        finish_deferred_ = false;
+        status = deferred_status_;
+    }
+    Finish(status);
+}
+
+// Finish the call once. A write already started (its StartWrite may not
+// even have been issued yet) completes first: Finish is left to writeFinished.
+void QueryFireReactor::finishOnce(const Status& status) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (finished_) return;
+        finished_ = true;
+        if (write_in_flight_) {
+            finish_deferred_ = true;
+            deferred_status_ = status;
+            return;
+        }
+    }
+    Finish(status);
+}
 
 void RunLeaderServer(const std::string& config_file) {
     ProcessConfig config = ConfigParser::loadConfig(config_file);
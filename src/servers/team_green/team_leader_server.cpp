@@ -3,7 +3,10 @@
 #include <string>
 #include <thread>
 #include <vector>
+#include <map>
+#include <set>
 #include <algorithm>
+#include <chrono>
 
 #include <grpc/grpc.h>
 #include <grpcpp/server.h>
@@ -15,7 +18,22 @@
 #include "fire_query.grpc.pb.h"
 #include "../../common/config.hpp"
 #include "../../common/fire_data_loader.hpp"
+#include "../../common/record_batch.hpp"
+#include "../../common/compression.hpp"
+#include "../../common/chunking.hpp"
+#include "../../common/merge_queue.hpp"
+#include "../../common/cancellation.hpp"
+#include "../../common/flow_control.hpp"
+#include "../../common/chunk_arena.hpp"
+#include "../../common/channel_pool.hpp"
+#include "../../common/replica_selection.hpp"
+#include "../../common/hedging.hpp"
+#include "../../common/pacing.hpp"
+#include "../../common/work_stealing.hpp"
+#include "../../common/repartitioning.hpp"
 #include "../../shmem/status_manager.hpp"
+#include "../../shmem/load_sampler.hpp"
+#include "../../shmem/chunk_ring.hpp"
 #include "../../common/metrics.hpp"
 
 using grpc::Server;
@@ -35,11 +53,20 @@ using firequery::HealthResponse;
 using firequery::CancelRequest;
 using firequery::CancelResponse;
 using firequery::FireRecord;
+using firequery::PartitionMapRequest;
+using firequery::PartitionMapResponse;
+using firequery::PartitionEntry;
+using firequery::CreditGrant;
+using firequery::CreditAck;
+using firequery::PartitionUpdate;
+using firequery::PartitionUpdateAck;
 
 class TeamLeaderServiceImpl final : public FireQueryService::Service {
 public:
     TeamLeaderServiceImpl(const ProcessConfig& config)
-        : config_(config), status_mgr_(false), data_loader_(config.data_path) {
+        : config_(config), status_mgr_(false), data_loader_(config.data_path, config.shared_dataset_dir),
+          partitioning_(config.data_partitioning),
+          process_pacing_(config.pacing_config.process_rate, config.pacing_config.burst) {
 
         std::cout << "Team Leader Process " << config_.process_id
                   << " (Team " << config_.team << ") starting..." << std::endl;
@@ -49,10 +76,14 @@ public:
         for (const auto& edge : config_.edges) {
             if (edge.relationship == "worker") {
                 std::string target = edge.host + ":" + std::to_string(edge.port);
-                auto channel = grpc::CreateChannel(target, grpc::InsecureChannelCredentials());
-                worker_stubs_[edge.to] = FireQueryService::NewStub(channel);
-
-                std::cout << "Connected to worker " << edge.to << " at " << target << std::endl;
+                worker_pools_[edge.to] = std::make_unique<ChannelPool>(target, edge.channel_pool_size);
+                worker_compression_[edge.to] = parseCompressionPolicy(edge.compression);
+                worker_ring_bytes_[edge.to] = chunkRingBytes(edge);
+
+                std::cout << "Connected to worker " << edge.to << " at " << target
+                          << " (compression: " << edge.compression
+                          << ", transport: " << (worker_ring_bytes_[edge.to] > 0 ? "shm" : "grpc")
+                          << ", connections: " << edge.channel_pool_size << ")" << std::endl;
             }
         }
 
@@ -63,8 +94,18 @@ public:
         }
         std::cout << std::endl;
 
+        if (data_loader_.sharedDataset().enabled()) {
+            std::cout << "Shared dataset: " << data_loader_.sharedDataset().dir() << std::endl;
+        }
+
         // Initialize metrics logging for this process
         metrics::init_with_dir("logs", config_.process_id, config_.role);
+
+        // Take our slot in the shared status registry and keep our load in it current
+        status_mgr_.registerProcess(config_.process_id, config_.team);
+        load_sampler_ = std::make_unique<LoadSampler>(status_mgr_, config_.process_id, config_.load_sample_ms,
+            [this]() { return LoadSampler::Gauges{scansWaitingForCpu(data_loader_.activeScans()),
+                                                  data_loader_.inflightScanBytes()}; });
     }
 
     Status DelegateQuery(ServerContext* context,
@@ -74,7 +115,7 @@ public:
         std::cout << "\n[Team Leader " << config_.process_id << "] Received delegation "
                   << request->request_id() << " from " << request->delegating_process() << std::endl;
 
-        metrics::log_event("RECEIVED_DELEGATION", request->request_id(), pending_requests_, worker_stubs_.size(), -1, -1, request->delegating_process());
+        metrics::log_event("RECEIVED_DELEGATION", request->request_id(), pending_requests_, worker_pools_.size(), -1, -1, request->delegating_process());
 
         // Update status
         {
@@ -89,19 +130,105 @@ public:
             return Status(grpc::StatusCode::INVALID_ARGUMENT, "Failed to parse original query");
         }
 
-        // Determine dates to process (intersection of query range and owned dates)
-        std::vector<std::string> dates_to_process = selectDatesToProcess(original_query);
+        // A direct (local_only) fetch is served from our own partition only
+        bool fan_out = !request->local_only();
+
+        // Dates to process: each date goes to one holder in the team picked by
+        // load; until the workers' partitions are known everyone serves its own
+        std::vector<DateUnit> units;
+        bool planned = fan_out && planTeamDates(original_query, *request, units);
+        if (!planned) {
+            units.clear();
+            DateUnit local{config_.process_id, selectDatesToProcess(original_query, *request), false, ""};
+            if (!local.dates.empty()) units.push_back(std::move(local));
+            for (const auto& [worker_id, pool] : worker_pools_) {
+                if (fan_out) units.push_back(DateUnit{worker_id, {}, false, ""});
+            }
+        }
 
-        std::cout << "  Processing " << dates_to_process.size() << " dates locally" << std::endl;
+        // Compression of our upstream stream follows the delegating edge's policy
+        StreamCompressor compressor(request->response_compression(), context,
+                                    request->delegating_process() + "->" + config_.process_id,
+                                    request->request_id());
+
+        // Cancelled by CancelQuery for this request id or by the leader dropping the stream
+        CancellationToken cancel;
+        cancel.watch([context]() { return context->IsCancelled(); });
+        ScopedCancellation registration(request->request_id(), cancel,
+                                        [context]() { context->TryCancel(); });
+
+        // With work stealing the planned units are split into hour-file tasks
+        // that every member (idle workers included) takes in turns
+        std::vector<std::string> members;
+        std::unique_ptr<TaskBoard> board;
+        if (planned && config_.work_stealing_config.enabled && original_query.max_records() <= 0) {
+            board = buildTaskBoard(*request, units, &members);
+        }
 
-        // Process own data first
-        if (!dates_to_process.empty()) {
-            processLocalData(original_query, dates_to_process, request->request_id(), writer);
+        // Start the local scan and every worker stream at once; this thread
+        // merges their chunks into the upstream writer. Worker calls inherit
+        // our call's cancellation (and deadline); each unit may need a second
+        // call for its hedge.
+        int producers = static_cast<int>(board ? members.size() * kTaskSlots : units.size());
+        MergeQueue<DelegationResponse> merged(kMergeBufferChunks, producers);
+        std::vector<std::unique_ptr<ClientContext>> worker_contexts;
+        for (size_t i = 0; !board && i < 2 * units.size(); ++i) {
+            worker_contexts.push_back(ClientContext::FromServerContext(*context));
+        }
+        std::vector<std::thread> producer_threads;
+        std::atomic<int> task_ids{0};
+
+        if (board) {
+            for (const auto& member : members) {
+                for (int slot = 0; slot < kTaskSlots; ++slot) {
+                    producer_threads.emplace_back([&, member]() {
+                        runTasks(member, *board, original_query, *request, context, merged, cancel, task_ids);
+                        merged.producerDone();
+                    });
+                }
+            }
         }
+        for (size_t i = 0; !board && i < units.size(); ++i) {
+            ClientContext* primary_ctx = worker_contexts[2 * i].get();
+            ClientContext* hedge_ctx = worker_contexts[2 * i + 1].get();
+            producer_threads.emplace_back([&, i, primary_ctx, hedge_ctx]() {
+                runUnit(units[i], original_query, *request, primary_ctx, hedge_ctx, merged, cancel);
+                merged.producerDone();
+            });
+        }
+
+        // Credit granted by our consumer gates every upstream write
+        StreamCredit upstream_credit(request->request_id(), request->delegating_process(),
+                                     request->credit_stream(), request->initial_credit());
+        ChunkRingWriter ring(producerRingBytes(request->shm_ring_bytes(), context->peer()), request->shm_ring_stream());
 
-        // Delegate to workers if any
-        if (!worker_stubs_.empty()) {
-            delegateToWorkers(request, &original_query, writer);
+        bool forwarded = forwardMerged(merged, writer, compressor, upstream_credit, ring, request->request_id(), cancel);
+        if (!forwarded) {
+            // Upstream is gone: stop the local scan and cancel the worker streams
+            merged.close();
+            for (auto& client_ctx : worker_contexts) client_ctx->TryCancel();
+        }
+        for (auto& t : producer_threads) t.join();
+        if (forwarded && !ring.finish(&cancel)) {
+            std::cerr << "  [Team Leader " << config_.process_id << "] Consumer did not drain the chunk ring" << std::endl;
+        }
+        if (ring.chunks() > 0) {
+            metrics::log_event("SHM_CHUNKS", request->request_id(), pending_requests_, worker_pools_.size(), ring.chunks(),
+                               static_cast<int>(ring.bytes() / 1024), "waits=" + std::to_string(ring.waits()));
+        }
+        Status result = Status::OK;
+        if (board) {
+            metrics::log_event("TASKS_DONE", request->request_id(), pending_requests_, worker_pools_.size(), -1,
+                               task_ids.load(), "stolen=" + std::to_string(board->stolen()) +
+                               ",left=" + std::to_string(board->remaining()) +
+                               ",lost=" + std::to_string(board->lost()));
+            // Rows are missing: tasks no live member could run, or ones that
+            // failed halfway and can't be retried without duplicating rows
+            if (!cancel.cancelled() && (board->remaining() > 0 || board->lost() > 0)) {
+                result = Status(grpc::StatusCode::UNAVAILABLE,
+                                std::to_string(board->remaining()) + " tasks left and " +
+                                std::to_string(board->lost()) + " lost by failed members");
+            }
         }
 
         std::cout << "[Team Leader " << config_.process_id << "] Delegation "
@@ -115,7 +242,7 @@ public:
             status_mgr_.updateProcessStatus(config_.process_id, pending_requests_, 1, completed_requests_);
         }
 
-        return Status::OK;
+        return result;
     }
 
     Status HealthCheck(ServerContext* context,
@@ -124,7 +251,73 @@ public:
         response->set_responding_process(config_.process_id);
         response->set_is_healthy(true);
         response->set_pending_requests(pending_requests_);
-        response->set_active_workers(worker_stubs_.size());
+        response->set_active_workers(worker_pools_.size());
+        return Status::OK;
+    }
+
+    Status GrantCredit(ServerContext* context,
+                       const CreditGrant* request,
+                       CreditAck* response) override {
+        response->set_accepted(CreditRegistry::instance().grant(
+            request->request_id(), request->consumer_process(), request->credit_stream(), request->chunks()));
+        return Status::OK;
+    }
+
+    // Our own partition followed by each worker's, with worker addresses from our edges
+    Status GetPartitionMap(ServerContext* context,
+                           const PartitionMapRequest* request,
+                           PartitionMapResponse* response) override {
+        PartitionEntry* self = response->add_entries();
+        *self = selfPartition();
+        addDateCosts(data_loader_.scanCosts(), self);
+        bool complete = true;
+
+        for (const auto& edge : config_.edges) {
+            if (edge.relationship != "worker") continue;
+
+            PartitionMapResponse worker_map;
+            if (!fetchWorkerPartition(edge, &worker_map)) {
+                complete = false;
+                continue;
+            }
+            for (auto& entry : *worker_map.mutable_entries()) {
+                response->add_entries()->Swap(&entry);
+            }
+        }
+        response->set_complete(complete);
+        return Status::OK;
+    }
+
+    // Ours is applied here; a worker's is relayed to it, and its cached
+    // partition dropped so the next plan sees the change
+    Status UpdatePartition(ServerContext* context,
+                           const PartitionUpdate* request,
+                           PartitionUpdateAck* response) override {
+        const std::string& target = request->process_id();
+        if (target.empty() || target == config_.process_id) {
+            applyPartitionUpdate(config_, partitioning_, data_loader_, *request, response);
+        } else {
+            auto pool = worker_pools_.find(target);
+            if (pool == worker_pools_.end()) {
+                return Status(grpc::StatusCode::NOT_FOUND, "No process " + target + " under " + config_.process_id);
+            }
+            ClientContext client_ctx;
+            client_ctx.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(2));
+            Status status = pool->second->stub()->UpdatePartition(&client_ctx, *request, response);
+            {
+                std::lock_guard<std::mutex> lock(partitions_mutex_);
+                worker_partitions_.erase(target);
+            }
+            if (!status.ok()) return status;
+        }
+
+        std::cout << "[Team Leader " << config_.process_id << "] Partition update for "
+                  << (target.empty() ? config_.process_id : target) << " from " << request->requesting_process()
+                  << ": " << (response->applied() ? "applied" : response->message()) << std::endl;
+        metrics::log_event("PARTITION_UPDATE", "", pending_requests_, worker_pools_.size(), -1,
+                           response->owned_dates_size(),
+                           (target.empty() ? config_.process_id : target) + ":" +
+                           (response->applied() ? "applied" : response->message()));
         return Status::OK;
     }
 
@@ -138,10 +331,12 @@ public:
     Status CancelQuery(ServerContext* context,
                       const CancelRequest* request,
                       CancelResponse* response) override {
+        int found = CancellationRegistry::instance().cancel(request->request_id());
         std::cout << "[Team Leader " << config_.process_id << "] Cancel request for "
-                  << request->request_id() << std::endl;
+                  << request->request_id() << " (" << found << " in flight)" << std::endl;
         response->set_request_id(request->request_id());
-        response->set_cancelled(true);
+        response->set_cancelled(found > 0);
+        response->set_message(found > 0 ? "Query cancelled" : "Query not in flight");
         return Status::OK;
     }
 
@@ -149,113 +344,599 @@ private:
     ProcessConfig config_;
     StatusManager status_mgr_;
     FireDataLoader data_loader_;
-    std::map<std::string, std::unique_ptr<FireQueryService::Stub>> worker_stubs_;
+    LivePartitioning partitioning_;  // config's partitioning, as changed by UpdatePartition
+    std::unique_ptr<LoadSampler> load_sampler_;
+    TokenBucket process_pacing_;  // shared by every local scan of this team leader
+    std::map<std::string, std::unique_ptr<ChannelPool>> worker_pools_;
+    std::map<std::string, firequery::CompressionPolicy> worker_compression_;
+    std::map<std::string, int> worker_ring_bytes_;  // chunk ring asked of each worker (0 = inline)
+    std::map<std::string, PartitionEntry> worker_partitions_;  // cached for replica planning
+    std::mutex partitions_mutex_;
+    LatencyTracker first_response_latency_;  // of every unit, for the hedge delay
+
+    using ChunkSink = std::function<bool(DelegationResponse&&)>;
+
+    // One process's share of a delegation, optionally hedged onto a backup holder
+    struct DateUnit {
+        std::string process_id;          // us or a worker
+        std::vector<std::string> dates;  // for workers: sent as target_dates
+        bool targeted;                   // false: worker gets the caller's targets (owned-date fallback)
+        std::string backup;              // holds every date of the unit; "" = no hedge
+    };
     int pending_requests_ = 0;
     int completed_requests_ = 0;
     std::mutex status_mutex_;
 
-    std::vector<std::string> selectDatesToProcess(const QueryRequest& query) {
-        std::vector<std::string> result;
+    // Chunks buffered between all producers of one delegation and the upstream writer
+    static constexpr size_t kMergeBufferChunks = 32;
+    // Appended to the request id of hedge copies sent to workers
+    static constexpr const char* kHedgeSuffix = "~hedge";
+    // Work stealing: tasks each member runs at once, and the request id suffix of task streams
+    static constexpr int kTaskSlots = 2;
+    static constexpr const char* kTaskSuffix = "~task";
+
+    std::vector<std::string> selectDatesToProcess(const QueryRequest& query,
+                                                  const DelegationRequest& request) {
+        return selectServedDates(partitioning_.get(), query.date_start(), query.date_end(),
+                                 request.target_dates());
+    }
+
+    PartitionEntry selfPartition() const {
+        DataPartitioning partitioning = partitioning_.get();
+        PartitionEntry self;
+        self.set_process_id(config_.process_id);
+        self.set_role(config_.role);
+        self.set_team(config_.team);
+        for (const auto& date : partitioning.owned_dates) {
+            self.add_owned_dates(date);
+        }
+        for (const auto& date : partitioning.replica_dates) {
+            self.add_replica_dates(date);
+        }
+        return self;
+    }
 
-        // Simple implementation: filter owned dates by query range
-        for (const auto& date : config_.data_partitioning.owned_dates) {
-            if (date >= query.date_start() && date <= query.date_end()) {
-                result.push_back(date);
+    // Ask one worker for its partition (address filled in from our edge) and cache it
+    bool fetchWorkerPartition(const EdgeConfig& edge, PartitionMapResponse* worker_map) {
+        auto pool = worker_pools_.find(edge.to);
+        if (pool == worker_pools_.end()) return false;
+
+        PartitionMapRequest worker_request;
+        worker_request.set_requesting_process(config_.process_id);
+        ClientContext client_ctx;
+        client_ctx.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(2));
+        Status status = pool->second->stub()->GetPartitionMap(&client_ctx, worker_request, worker_map);
+        if (!status.ok()) {
+            std::cerr << "  [Team Leader " << config_.process_id << "] Worker " << edge.to
+                      << " partition map unavailable: " << status.error_message() << std::endl;
+            return false;
+        }
+        for (auto& entry : *worker_map->mutable_entries()) {
+            if (entry.address().empty()) {
+                entry.set_address(edge.host + ":" + std::to_string(edge.port));
+            }
+            if (entry.process_id() == edge.to) {
+                std::lock_guard<std::mutex> lock(partitions_mutex_);
+                worker_partitions_[edge.to] = entry;
             }
         }
+        return true;
+    }
 
-        return result;
+    // Partitions of every worker, fetching the ones not cached yet. False if any is unreachable.
+    bool workerPartitions(std::vector<PartitionEntry>* entries) {
+        for (const auto& edge : config_.edges) {
+            if (edge.relationship != "worker") continue;
+            {
+                std::lock_guard<std::mutex> lock(partitions_mutex_);
+                auto it = worker_partitions_.find(edge.to);
+                if (it != worker_partitions_.end()) {
+                    entries->push_back(it->second);
+                    continue;
+                }
+            }
+            PartitionMapResponse worker_map;
+            if (!fetchWorkerPartition(edge, &worker_map)) return false;
+            std::lock_guard<std::mutex> lock(partitions_mutex_);
+            auto it = worker_partitions_.find(edge.to);
+            if (it == worker_partitions_.end()) return false;
+            entries->push_back(it->second);
+        }
+        return true;
+    }
+
+    // Give each date of the query to one holder in the team (us or a worker),
+    // least loaded first; workers left without dates are not called. Without
+    // targets only dates owned by a team member are served; with targets,
+    // every targeted date held here. Returns false while a worker's partition
+    // is unknown; then every process serves its own owned dates as before.
+    bool planTeamDates(const QueryRequest& query,
+                       const DelegationRequest& request,
+                       std::vector<DateUnit>& units) {
+        std::vector<PartitionEntry> members{selfPartition()};
+        if (!workerPartitions(&members)) return false;
+
+        const auto& targets = request.target_dates();
+        auto wanted = [&](const std::string& date) {
+            if (date < query.date_start() || date > query.date_end()) return false;
+            return targets.empty() || std::find(targets.begin(), targets.end(), date) != targets.end();
+        };
+
+        // Our own pending count already includes this delegation
+        auto load = [this](const std::string& process_id) {
+            double score = status_mgr_.getProcessLoad(process_id);
+            return process_id == config_.process_id ? score - StatusManager::kPendingScore : score;
+        };
+        ReplicaPlanner planner(load);
+        std::set<std::string> owned_in_team;
+        for (const auto& member : members) {
+            for (const auto& date : member.owned_dates()) {
+                if (!wanted(date)) continue;
+                planner.addHolder(date, member.process_id());
+                owned_in_team.insert(date);
+            }
+        }
+        for (const auto& member : members) {
+            for (const auto& date : member.replica_dates()) {
+                if (!wanted(date)) continue;
+                if (targets.empty() && !owned_in_team.count(date)) continue;
+                planner.addHolder(date, member.process_id());
+            }
+        }
+
+        std::string summary;
+        for (auto& [process_id, dates] : planner.assign()) {
+            if (!summary.empty()) summary += ",";
+            summary += process_id + "=" + std::to_string(dates.size());
+            units.push_back(DateUnit{process_id, std::move(dates), true, ""});
+        }
+
+        // A unit's hedge goes to the least-loaded other member holding all its dates
+        if (config_.hedge_config.percentile > 0) {
+            for (auto& unit : units) {
+                double best_load = 0;
+                for (const auto& member : members) {
+                    if (member.process_id() == unit.process_id || !holdsAll(member, unit.dates)) continue;
+                    double member_load = load(member.process_id());
+                    if (unit.backup.empty() || member_load < best_load) {
+                        unit.backup = member.process_id();
+                        best_load = member_load;
+                    }
+                }
+            }
+        }
+        metrics::log_event("DATE_PLAN", request.request_id(), pending_requests_, worker_pools_.size(), -1, -1, summary);
+        std::cout << "  Date plan (dates per process): " << summary << std::endl;
+        return true;
     }
 
-    void processLocalData(const QueryRequest& query,
-                         const std::vector<std::string>& dates,
-                         const std::string& request_id,
-                         ServerWriter<DelegationResponse>* writer) {
-
-        std::cout << "  [Team Leader " << config_.process_id << "] Loading local data..." << std::endl;
-
-        // Load data
-        std::vector<FireDataRecord> records = data_loader_.loadData(
-            dates,
-            query.pollutant_type(),
-            query.latitude_min(),
-            query.latitude_max(),
-            query.longitude_min(),
-            query.longitude_max(),
-            query.max_records()
-        );
-
-        std::cout << "  [Team Leader " << config_.process_id << "] Loaded "
-                  << records.size() << " records" << std::endl;
-
-        // Send in chunks
-        int chunk_size = config_.chunk_config.default_chunk_size;
+    // Scan our own dates (or, for a task, the given files) into emit.
+    // Returns false if stopped early (cancelled or emit refused).
+    bool processLocalData(const QueryRequest& query,
+                          const std::vector<std::string>& dates,
+                          const std::string& request_id,
+                          const ChunkSink& emit,
+                          const CancellationToken& cancel,
+                          const std::vector<std::string>* files = nullptr) {
+
+        std::cout << "  [Team Leader " << config_.process_id << "] Scanning local data..." << std::endl;
+
+        // Chunks are cut straight out of the scan; a full merge buffer pauses the scan
+        ChunkSizer sizer(query, config_.chunk_config);
         int chunk_count = 0;
+        std::vector<FireDataRecord> pending;
+        pending.reserve(static_cast<size_t>(sizer.next()));
+        ChunkArena arena;  // scratch RecordBatches; the chunk itself outlives us in the merge queue
+        StreamPacer pacer(config_.pacing_config, process_pacing_);
+        bool stopped = false;
 
-        for (size_t i = 0; i < records.size(); i += chunk_size) {
+        auto push_pending = [&]() -> bool {
             DelegationResponse chunk_resp;
             chunk_resp.set_request_id(request_id);
             chunk_resp.set_chunk_number(chunk_count++);
             chunk_resp.set_is_final(false);
             chunk_resp.set_responding_process(config_.process_id);
 
-            size_t end = std::min(i + chunk_size, records.size());
-            for (size_t j = i; j < end; j++) {
-                auto* rec = chunk_resp.add_records();
-                convertToProto(records[j], rec);
+            int chunk_records = static_cast<int>(pending.size());
+            if (query.record_format() == firequery::COLUMNAR_BATCH) {
+                firequery::RecordBatch* batch = arena.create<firequery::RecordBatch>();
+                RecordBatchBuilder builder(batch);
+                builder.reserve(chunk_records);
+                for (const auto& record : pending) {
+                    builder.add(record);
+                }
+                setBatchPayload(*batch, &chunk_resp);
+                arena.reset();
+            } else {
+                chunk_resp.mutable_records()->Reserve(chunk_records);
+                for (const auto& record : pending) {
+                    convertToProto(record, chunk_resp.add_records());
+                }
+                chunk_resp.set_record_count(chunk_records);
             }
+            pending.clear();
+
+            size_t chunk_bytes = chunk_resp.ByteSizeLong();
+            if (!pacer.pace(chunk_bytes, chunk_records, &cancel)) return false;
 
             // Metrics: local chunk sent
-            metrics::log_event("DELEGATION_CHUNK_SENT", request_id, pending_requests_, worker_stubs_.size(), chunk_resp.chunk_number(), chunk_resp.records_size(), config_.process_id);
+            metrics::log_event("DELEGATION_CHUNK_SENT", request_id, pending_requests_, worker_pools_.size(), chunk_resp.chunk_number(), chunk_records, config_.process_id);
 
-            if (!writer->Write(chunk_resp)) {
-                std::cerr << "  [Team Leader " << config_.process_id
-                          << "] Failed to write chunk" << std::endl;
-                // Metrics: failed to send delegation chunk upstream
-                metrics::log_event("DELEGATION_CHUNK_SEND_ERROR", request_id, pending_requests_, worker_stubs_.size(), chunk_resp.chunk_number(), chunk_resp.records_size(), config_.process_id);
-                return;
+            // Time blocked on a full merge buffer is the upstream backpressure signal
+            auto push_start = std::chrono::steady_clock::now();
+            if (!emit(std::move(chunk_resp))) {
+                stopped = true;  // upstream write failed or our hedge lost, nothing more to send
+                return false;
             }
+            sizer.record(chunk_bytes, chunk_records, std::chrono::steady_clock::now() - push_start);
+            return true;
+        };
+
+        auto sink = [&](FireDataRecord&& record) {
+            pending.push_back(std::move(record));
+            if (pending.size() < static_cast<size_t>(sizer.next())) return true;
+            return push_pending();
+        };
+        size_t scanned = files
+            ? data_loader_.scanFiles(*files, query.pollutant_type(), query.latitude_min(), query.latitude_max(),
+                                     query.longitude_min(), query.longitude_max(), query.max_records(), &cancel, sink)
+            : data_loader_.scanData(dates, query.pollutant_type(), query.latitude_min(), query.latitude_max(),
+                                    query.longitude_min(), query.longitude_max(), query.max_records(), &cancel, sink);
+        if (!pending.empty() && !stopped && !cancel.cancelled()) {
+            push_pending();
+        }
+
+        if (pacer.throttledChunks() > 0) {
+            metrics::log_event("PACING_THROTTLED", request_id, pending_requests_, worker_pools_.size(),
+                               pacer.throttledChunks(), static_cast<int>(pacer.throttledMs()), config_.process_id);
+        }
 
-            // Metrics: local chunk sent (only after successful write)
-            metrics::log_event("DELEGATION_CHUNK_SENT", request_id, pending_requests_, worker_stubs_.size(), chunk_resp.chunk_number(), chunk_resp.records_size(), config_.process_id);
+        std::cout << "  [Team Leader " << config_.process_id << "] Scanned "
+                  << scanned << " records" << std::endl;
+        return !stopped && !cancel.cancelled();
+    }
 
-            std::cout << "  [Team Leader " << config_.process_id << "] Sent chunk "
-                      << chunk_count - 1 << " with " << chunk_resp.records_size() << " records" << std::endl;
+    // Stream one worker's chunks into emit
+    Status delegateToWorker(const std::string& worker_id,
+                            const std::string& request_id,
+                            ChannelPool::Lease channel,
+                            ClientContext* client_ctx,
+                            const DelegationRequest& request,
+                            const std::vector<std::string>* target_dates,
+                            const ChunkSink& emit,
+                            const std::vector<std::string>* target_files = nullptr) {
+
+        std::cout << "  [Team Leader " << config_.process_id << "] Delegating to worker "
+                  << worker_id << std::endl;
+
+        // Same delegation on our edge to the worker: its compression, our credit window
+        DelegationRequest worker_request = request;
+        worker_request.set_request_id(request_id);
+        worker_request.set_delegating_process(config_.process_id);
+        worker_request.set_response_compression(worker_compression_[worker_id]);
+        worker_request.set_initial_credit(config_.chunk_config.credit_window);
+        worker_request.set_credit_stream(newCreditStream());
+        worker_request.set_shm_ring_bytes(worker_ring_bytes_[worker_id]);
+        worker_request.set_shm_ring_stream(newChunkRingStream());
+        if (target_dates) {
+            // Dates picked for this worker by the replica plan
+            worker_request.clear_target_dates();
+            for (const auto& date : *target_dates) worker_request.add_target_dates(date);
         }
+        if (target_files) {
+            for (const auto& file : *target_files) worker_request.add_target_files(file);
+        }
+
+        std::unique_ptr<grpc::ClientReader<DelegationResponse>> reader(
+            channel.stub()->DelegateQuery(client_ctx, worker_request));
+
+        ChunkRingReader ring(worker_request.shm_ring_stream());
+        DelegationResponse delegation_resp;
+        while (reader->Read(&delegation_resp)) {
+            if (!ring.resolve(delegation_resp)) {
+                std::cerr << "  [Team Leader " << config_.process_id << "] Bad chunk ring reference from "
+                          << worker_id << std::endl;
+                client_ctx->TryCancel();
+                break;
+            }
+            delegation_resp.set_credit_stream(worker_request.credit_stream());
+            if (!emit(std::move(delegation_resp))) {
+                client_ctx->TryCancel();
+                break;
+            }
+            delegation_resp.Clear();
+        }
+
+        Status status = reader->Finish();
+        if (!status.ok() && status.error_code() != grpc::StatusCode::CANCELLED) {
+            std::cerr << "  [Team Leader " << config_.process_id << "] Worker "
+                      << worker_id << " error: " << status.error_message() << std::endl;
+        }
+        return status;
     }
 
-    void delegateToWorkers(const DelegationRequest* request,
-                          const QueryRequest* original_query,
-                          ServerWriter<DelegationResponse>* writer) {
+    static bool holdsAll(const PartitionEntry& member, const std::vector<std::string>& dates) {
+        auto holds = [&member](const std::string& date) {
+            return std::find(member.owned_dates().begin(), member.owned_dates().end(), date) != member.owned_dates().end() ||
+                   std::find(member.replica_dates().begin(), member.replica_dates().end(), date) != member.replica_dates().end();
+        };
+        return !dates.empty() && std::all_of(dates.begin(), dates.end(), holds);
+    }
 
-        for (auto& [worker_id, stub] : worker_stubs_) {
-            std::cout << "  [Team Leader " << config_.process_id << "] Delegating to worker "
-                      << worker_id << std::endl;
+    // Serve one unit's dates from holder into emit: a local scan or a worker stream.
+    // A hedge copy of a worker stream runs under its own request id so the
+    // worker keeps its credit and cancellation apart from the primary's.
+    bool runCopy(const DateUnit& unit, const std::string& holder, bool hedge,
+                 const QueryRequest& query, const DelegationRequest& request,
+                 ClientContext* client_ctx, const CancellationToken& cancel, const ChunkSink& emit) {
+        if (holder == config_.process_id) {
+            return processLocalData(query, unit.dates, request.request_id(), emit, cancel);
+        }
+        auto pool = worker_pools_.find(holder);
+        if (pool == worker_pools_.end()) return false;
+        std::string request_id = hedge ? request.request_id() + kHedgeSuffix : request.request_id();
+        const std::vector<std::string>* targets = unit.targeted ? &unit.dates : nullptr;
+        return delegateToWorker(holder, request_id, pool->second->acquire(), client_ctx, request,
+                                targets, emit).ok();
+    }
 
-            ClientContext client_ctx;
-            std::unique_ptr<grpc::ClientReader<DelegationResponse>> reader(
-                stub->DelegateQuery(&client_ctx, *request));
-
-            DelegationResponse delegation_resp;
-            while (reader->Read(&delegation_resp)) {
-                // Forward worker's response to leader
-                if (!writer->Write(delegation_resp)) {
-                    std::cerr << "  [Team Leader " << config_.process_id
-                              << "] Failed to forward worker response" << std::endl;
-                    reader->Finish();
-                    return;
+    // Run one unit. With a backup holder, a hedge copy starts once the primary
+    // has not responded within the configured percentile of recent first-response
+    // latencies (or right away if the primary fails first). The first copy to
+    // respond wins and the other is cancelled before any of its chunks are used.
+    void runUnit(const DateUnit& unit, const QueryRequest& query, const DelegationRequest& request,
+                 ClientContext* primary_ctx, ClientContext* hedge_ctx,
+                 MergeQueue<DelegationResponse>& merged, const CancellationToken& cancel) {
+        const std::string& request_id = request.request_id();
+        std::mutex first_mutex;
+        bool responded = false;
+        auto first_response = [&](std::chrono::steady_clock::time_point started) {
+            std::lock_guard<std::mutex> lock(first_mutex);
+            if (responded) return;
+            responded = true;
+            first_response_latency_.record(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - started));
+        };
+
+        if (unit.backup.empty()) {
+            auto started = std::chrono::steady_clock::now();
+            runCopy(unit, unit.process_id, false, query, request, primary_ctx, cancel,
+                    [&](DelegationResponse&& chunk) {
+                        first_response(started);
+                        return merged.push(std::move(chunk));
+                    });
+            return;
+        }
+
+        // Each copy stops on its own token (local scan) or context (worker) when it loses
+        HedgeRace race;
+        CancellationToken primary_cancel, hedge_cancel;
+        primary_cancel.watch([&cancel]() { return cancel.cancelled(); });
+        hedge_cancel.watch([&cancel]() { return cancel.cancelled(); });
+
+        auto run = [&](int copy, const std::string& holder, bool hedge, ClientContext* client_ctx,
+                       const CancellationToken& copy_cancel) {
+            auto started = std::chrono::steady_clock::now();
+            bool ok = runCopy(unit, holder, hedge, query, request, client_ctx, copy_cancel,
+                              [&, copy, started](DelegationResponse&& chunk) {
+                                  if (!race.claim(copy)) return false;
+                                  first_response(started);
+                                  return merged.push(std::move(chunk));
+                              });
+            if (ok && race.claim(copy)) {
+                first_response(started);
+            } else if (!ok) {
+                race.fail(copy);
+            }
+        };
+
+        int primary = race.addCopy([&]() { primary_cancel.cancel(); primary_ctx->TryCancel(); });
+        std::thread primary_thread(run, primary, unit.process_id, false, primary_ctx, std::cref(primary_cancel));
+
+        auto delay = first_response_latency_.percentile(
+            config_.hedge_config.percentile, std::chrono::milliseconds(config_.hedge_config.min_delay_ms));
+        std::thread hedge_thread;
+        if (!race.waitFor(delay) || race.winner() == HedgeRace::kNone) {
+            int hedge = race.addCopy([&]() { hedge_cancel.cancel(); hedge_ctx->TryCancel(); });
+            if (hedge != HedgeRace::kNone && !cancel.cancelled()) {
+                std::cout << "  [Team Leader " << config_.process_id << "] Hedging " << unit.process_id
+                          << " (" << unit.dates.size() << " dates) onto " << unit.backup
+                          << " after " << delay.count() << " ms" << std::endl;
+                metrics::log_event("HEDGE_SENT", request_id, pending_requests_, worker_pools_.size(), -1,
+                                   static_cast<int>(delay.count()), unit.process_id + "->" + unit.backup);
+                hedge_thread = std::thread(run, hedge, unit.backup, true, hedge_ctx, std::cref(hedge_cancel));
+            }
+        }
+
+        primary_thread.join();
+        if (hedge_thread.joinable()) {
+            hedge_thread.join();
+            std::string winner = race.winner() == primary ? unit.process_id
+                               : race.winner() == HedgeRace::kNone ? "none" : unit.backup;
+            metrics::log_event("HEDGE_RESULT", request_id, pending_requests_, worker_pools_.size(), -1, -1,
+                               "winner=" + winner);
+        }
+    }
+
+    // Hour-file tasks of the planned units, queued on the member each unit was
+    // planned for. Dates whose files we cannot list here become one whole-date
+    // task, which only their holders may run; with shared storage any member
+    // may run any file task.
+    std::unique_ptr<TaskBoard> buildTaskBoard(const DelegationRequest& request,
+                                              const std::vector<DateUnit>& units,
+                                              std::vector<std::string>* members) {
+        std::vector<PartitionEntry> entries{selfPartition()};
+        workerPartitions(&entries);
+        std::map<std::string, std::set<std::string>> held;
+        for (const auto& entry : entries) {
+            if (entry.process_id() != config_.process_id && !worker_pools_.count(entry.process_id())) continue;
+            members->push_back(entry.process_id());
+            auto& dates = held[entry.process_id()];
+            dates.insert(entry.owned_dates().begin(), entry.owned_dates().end());
+            dates.insert(entry.replica_dates().begin(), entry.replica_dates().end());
+        }
+
+        bool shared = config_.work_stealing_config.shared_storage;
+        auto board = std::make_unique<TaskBoard>([held, shared](const std::string& member, const ScanTask& task) {
+            if (shared && !task.file.empty()) return true;
+            auto it = held.find(member);
+            return it != held.end() && it->second.count(task.date) > 0;
+        });
+
+        int tasks = 0;
+        for (const auto& unit : units) {
+            for (const auto& date : unit.dates) {
+                std::vector<std::string> files = data_loader_.listFiles(date);
+                if (files.empty()) {
+                    board->add(unit.process_id, ScanTask{date, ""});
+                    tasks++;
+                }
+                for (auto& file : files) {
+                    board->add(unit.process_id, ScanTask{date, std::move(file)});
+                    tasks++;
                 }
+            }
+        }
+        metrics::log_event("TASK_PLAN", request.request_id(), pending_requests_, worker_pools_.size(), -1, tasks,
+                           "members=" + std::to_string(members->size()) + (shared ? ",shared" : ""));
+        std::cout << "  Work stealing: " << tasks << " tasks across " << members->size() << " members" << std::endl;
+        return board;
+    }
 
-                std::cout << "  [Team Leader " << config_.process_id << "] Forwarded chunk from "
-                          << delegation_resp.responding_process() << " with "
-                          << delegation_resp.records_size() << " records" << std::endl;
+    // One task slot of a member: its own tasks first, then stolen ones, until
+    // the board has none left it can run. A worker task runs as its own
+    // stream. A member whose task fails stops taking tasks; the task goes
+    // back on the board for the others unless it already sent rows.
+    void runTasks(const std::string& member, TaskBoard& board, const QueryRequest& query,
+                  const DelegationRequest& request, ServerContext* context,
+                  MergeQueue<DelegationResponse>& merged, const CancellationToken& cancel,
+                  std::atomic<int>& task_ids) {
+        auto stop = [&cancel]() { return cancel.cancelled(); };
+        while (true) {
+            auto claim = board.next(member, stop);
+            if (!claim) return;
+            const ScanTask& task = claim->task;
+            const std::string& what = task.file.empty() ? task.date : task.file;
+            if (claim->owner != member) {
+                metrics::log_event("TASK_STOLEN", request.request_id(), pending_requests_, worker_pools_.size(), -1, -1,
+                                   member + "<-" + claim->owner + ":" + what);
             }
 
-            Status status = reader->Finish();
-            if (!status.ok()) {
-                std::cerr << "  [Team Leader " << config_.process_id << "] Worker "
-                          << worker_id << " error: " << status.error_message() << std::endl;
+            bool sent = false, refused = false;
+            auto emit = [&](DelegationResponse&& chunk) {
+                sent = true;
+                refused = !merged.push(std::move(chunk));
+                return !refused;
+            };
+            std::vector<std::string> dates{task.date};
+            std::vector<std::string> files;
+            if (!task.file.empty()) files.push_back(task.file);
+            const std::vector<std::string>* task_files = files.empty() ? nullptr : &files;
+
+            bool ok;
+            int task_id = task_ids++;
+            if (member == config_.process_id) {
+                ok = processLocalData(query, dates, request.request_id(), emit, cancel, task_files);
+            } else {
+                auto client_ctx = ClientContext::FromServerContext(*context);
+                ok = delegateToWorker(member, request.request_id() + kTaskSuffix + std::to_string(task_id),
+                                      worker_pools_[member]->acquire(), client_ctx.get(), request, &dates,
+                                      emit, task_files).ok();
+            }
+            if (ok || refused || cancel.cancelled()) {
+                board.done();
+                if (ok) continue;
+                return;
             }
+
+            std::cerr << "  [Team Leader " << config_.process_id << "] Task " << what << " failed on "
+                      << member << (sent ? " after sending rows" : "") << std::endl;
+            metrics::log_event("TASK_FAILED", request.request_id(), pending_requests_, worker_pools_.size(), -1, -1,
+                               member + ":" + what + (sent ? ",partial" : ""));
+            board.fail(member, std::move(*claim), sent);
+            return;
+        }
+    }
+
+    // Write merged chunks upstream in arrival order. Returns false if the upstream write failed.
+    bool forwardMerged(MergeQueue<DelegationResponse>& merged,
+                       ServerWriter<DelegationResponse>* writer,
+                       StreamCompressor& compressor,
+                       StreamCredit& upstream_credit,
+                       ChunkRingWriter& ring,
+                       const std::string& request_id,
+                       const CancellationToken& cancel) {
+
+        DelegationResponse chunk;
+        DelegationResponse ring_ref;
+        int written_chunks = 0;
+        std::map<std::string, CreditReturner> worker_credit;
+        while (merged.pop(chunk)) {
+            if (cancel.cancelled()) {
+                std::cout << "  [Team Leader " << config_.process_id << "] Delegation "
+                          << request_id << " cancelled" << std::endl;
+                metrics::log_event("DELEGATION_CANCELLED", request_id, pending_requests_, worker_pools_.size(), written_chunks, -1, config_.process_id);
+                return false;
+            }
+
+            int chunk_records = chunkRecordCount(chunk);
+            bool local = chunk.responding_process() == config_.process_id;
+
+            // Hedge copies run under their own request id; upstream only knows ours
+            std::string stream_id = chunk.request_id();
+            uint64_t credit_stream = chunk.credit_stream();
+            chunk.set_request_id(request_id);
+            chunk.clear_credit_stream();
+
+            if (!upstream_credit.acquire(&cancel)) {
+                return false;
+            }
+
+            // Batch payloads from workers pass through as opaque bytes
+            bool by_ref = ring.put(chunk, &ring_ref, &cancel);
+            grpc::WriteOptions write_options = by_ref
+                ? grpc::WriteOptions().set_no_compression()
+                : compressor.nextWriteOptions(chunk, written_chunks);
+            written_chunks++;
+            auto write_start = std::chrono::steady_clock::now();
+            bool written = writer->Write(by_ref ? ring_ref : chunk, write_options);
+            if (!by_ref) compressor.recordWrite(std::chrono::steady_clock::now() - write_start);
+            if (!written) {
+                std::cerr << "  [Team Leader " << config_.process_id
+                          << "] Failed to write chunk upstream" << std::endl;
+                // Metrics: failed to send delegation chunk upstream
+                metrics::log_event("DELEGATION_CHUNK_SEND_ERROR", request_id, pending_requests_, worker_pools_.size(), chunk.chunk_number(), chunk_records, chunk.responding_process());
+                return false;
+            }
+
+            if (local) {
+                // Metrics: local chunk sent (only after successful write)
+                metrics::log_event("DELEGATION_CHUNK_SENT", request_id, pending_requests_, worker_pools_.size(), chunk.chunk_number(), chunk_records, config_.process_id);
+                std::cout << "  [Team Leader " << config_.process_id << "] Sent chunk "
+                          << chunk.chunk_number() << " with " << chunk_records << " records" << std::endl;
+            } else {
+                std::cout << "  [Team Leader " << config_.process_id << "] Forwarded chunk from "
+                          << chunk.responding_process() << " with "
+                          << chunk_records << " records" << std::endl;
+                returnWorkerCredit(worker_credit, chunk.responding_process(), stream_id, credit_stream);
+            }
+        }
+        return true;
+    }
+
+    // A worker chunk left this process: hand its credit back (batched)
+    void returnWorkerCredit(std::map<std::string, CreditReturner>& returners,
+                            const std::string& worker_id,
+                            const std::string& request_id,
+                            uint64_t credit_stream) {
+        int window = config_.chunk_config.credit_window;
+        auto pool = worker_pools_.find(worker_id);
+        if (window <= 0 || pool == worker_pools_.end()) return;
+
+        auto it = returners.try_emplace(std::to_string(credit_stream), window).first;
+        int grant = it->second.consumed();
+        if (grant > 0) {
+            grantCreditAsync(pool->second->stub(), request_id, config_.process_id, credit_stream, grant);
         }
     }
 
@@ -2,7 +2,6 @@
 #include <memory>
 #include <string>
 #include <algorithm>
-#include <thread>
 #include <chrono>
 
 #include <grpc/grpc.h>
@@ -14,7 +13,18 @@
 #include "fire_query.grpc.pb.h"
 #include "../../common/config.hpp"
 #include "../../common/fire_data_loader.hpp"
+#include "../../common/record_batch.hpp"
+#include "../../common/compression.hpp"
+#include "../../common/chunking.hpp"
+#include "../../common/cancellation.hpp"
+#include "../../common/flow_control.hpp"
+#include "../../common/chunk_arena.hpp"
+#include "../../common/replica_selection.hpp"
+#include "../../common/pacing.hpp"
+#include "../../common/repartitioning.hpp"
 #include "../../shmem/status_manager.hpp"
+#include "../../shmem/load_sampler.hpp"
+#include "../../shmem/chunk_ring.hpp"
 #include "../../common/metrics.hpp"
 
 using grpc::Server;
@@ -32,11 +42,19 @@ using firequery::HealthResponse;
 using firequery::CancelRequest;
 using firequery::CancelResponse;
 using firequery::FireRecord;
+using firequery::PartitionMapRequest;
+using firequery::PartitionMapResponse;
+using firequery::CreditGrant;
+using firequery::CreditAck;
+using firequery::PartitionUpdate;
+using firequery::PartitionUpdateAck;
 
 class WorkerServiceImpl final : public FireQueryService::Service {
 public:
     WorkerServiceImpl(const ProcessConfig& config)
-        : config_(config), status_mgr_(false), data_loader_(config.data_path) {
+        : config_(config), status_mgr_(false), data_loader_(config.data_path, config.shared_dataset_dir),
+          partitioning_(config.data_partitioning),
+          process_pacing_(config.pacing_config.process_rate, config.pacing_config.burst) {
 
         std::cout << "Worker Process " << config_.process_id
                   << " (Team " << config_.team << ") starting..." << std::endl;
@@ -49,8 +67,18 @@ public:
         }
         std::cout << std::endl;
 
+        if (data_loader_.sharedDataset().enabled()) {
+            std::cout << "Shared dataset: " << data_loader_.sharedDataset().dir() << std::endl;
+        }
+
         // Initialize metrics logging for this process
         metrics::init_with_dir("logs", config_.process_id, config_.role);
+
+        // Take our slot in the shared status registry and keep our load in it current
+        status_mgr_.registerProcess(config_.process_id, config_.team);
+        load_sampler_ = std::make_unique<LoadSampler>(status_mgr_, config_.process_id, config_.load_sample_ms,
+            [this]() { return LoadSampler::Gauges{scansWaitingForCpu(data_loader_.activeScans()),
+                                                  data_loader_.inflightScanBytes()}; });
     }
 
     Status DelegateQuery(ServerContext* context,
@@ -62,6 +90,12 @@ public:
 
         metrics::log_event("RECEIVED_DELEGATION", request->request_id(), pending_requests_, 1, -1, -1, request->delegating_process());
 
+        std::string bad_file = checkTargetFiles(*request);
+        if (!bad_file.empty()) {
+            std::cerr << "  [Worker " << config_.process_id << "] Refusing task: " << bad_file << std::endl;
+            return Status(grpc::StatusCode::INVALID_ARGUMENT, bad_file);
+        }
+
         // Update status
         {
             std::lock_guard<std::mutex> lock(status_mutex_);
@@ -75,13 +109,19 @@ public:
             return Status(grpc::StatusCode::INVALID_ARGUMENT, "Failed to parse original query");
         }
 
-        // Determine dates to process
-        std::vector<std::string> dates_to_process = selectDatesToProcess(original_query);
-
-        std::cout << "  [Worker " << config_.process_id << "] Processing "
-                  << dates_to_process.size() << " dates" << std::endl;
+        // A work-stealing task names its files; otherwise scan the dates we serve
+        std::vector<std::string> files(request->target_files().begin(), request->target_files().end());
+        std::vector<std::string> dates_to_process;
+        if (files.empty()) {
+            dates_to_process = selectDatesToProcess(original_query, *request);
+            std::cout << "  [Worker " << config_.process_id << "] Processing "
+                      << dates_to_process.size() << " dates" << std::endl;
+        } else {
+            std::cout << "  [Worker " << config_.process_id << "] Processing "
+                      << files.size() << " files" << std::endl;
+        }
 
-        if (dates_to_process.empty()) {
+        if (dates_to_process.empty() && files.empty()) {
             std::cout << "  [Worker " << config_.process_id << "] No matching dates in partition" << std::endl;
             {
                 std::lock_guard<std::mutex> lock(status_mutex_);
@@ -92,64 +132,139 @@ public:
             return Status::OK;
         }
 
-        // Load data
-        auto start_time = std::chrono::high_resolution_clock::now();
-
-        std::vector<FireDataRecord> records = data_loader_.loadData(
-            dates_to_process,
-            original_query.pollutant_type(),
-            original_query.latitude_min(),
-            original_query.latitude_max(),
-            original_query.longitude_min(),
-            original_query.longitude_max(),
-            original_query.max_records()
-        );
-
-        auto end_time = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-
-        std::cout << "  [Worker " << config_.process_id << "] Loaded " << records.size()
-                  << " records in " << duration.count() << "ms" << std::endl;
-
-        metrics::log_event("LOADED_RECORDS", request->request_id(), pending_requests_, 1, -1, records.size(), "loaded by worker");
-
-        // Send in chunks
-        int chunk_size = config_.chunk_config.default_chunk_size;
+        // Cancelled by CancelQuery for this request id or by the caller dropping the stream
+        CancellationToken cancel;
+        cancel.watch([context]() { return context->IsCancelled(); });
+        ScopedCancellation registration(request->request_id(), cancel,
+                                        [context]() { context->TryCancel(); });
+
+        // Records are chunked and sent straight out of the scan. With credit flow
+        // control the scan pauses while the consumer has granted no credit, so at
+        // most one chunk of records is held here however slow the consumer is.
+        ChunkSizer sizer(original_query, config_.chunk_config);
+        StreamCompressor compressor(request->response_compression(), context,
+                                    request->delegating_process() + "->" + config_.process_id,
+                                    request->request_id());
+        StreamCredit credit(request->request_id(), request->delegating_process(), request->credit_stream(),
+                            request->initial_credit());
+        StreamPacer pacer(config_.pacing_config, process_pacing_);
+        // A consumer on this host reads chunk payloads from shared memory; only references go over gRPC
+        ChunkRingWriter ring(producerRingBytes(request->shm_ring_bytes(), context->peer()), request->shm_ring_stream());
+        DelegationResponse ring_ref;
         int chunk_count = 0;
+        bool write_failed = false;
+        std::vector<FireDataRecord> pending;
+        pending.reserve(static_cast<size_t>(sizer.next()));
+        ChunkArena arena;  // chunk messages are built here and released after each write
 
-        for (size_t i = 0; i < records.size(); i += chunk_size) {
-            DelegationResponse chunk_resp;
+        auto send_pending = [&]() -> bool {
+            if (!credit.acquire(&cancel)) return false;
+
+            DelegationResponse& chunk_resp = *arena.create<DelegationResponse>();
             chunk_resp.set_request_id(request->request_id());
             chunk_resp.set_chunk_number(chunk_count++);
             chunk_resp.set_is_final(false);
             chunk_resp.set_responding_process(config_.process_id);
 
-            size_t end = std::min(i + chunk_size, records.size());
-            for (size_t j = i; j < end; j++) {
-                auto* rec = chunk_resp.add_records();
-                convertToProto(records[j], rec);
+            int chunk_records = static_cast<int>(pending.size());
+            if (original_query.record_format() == firequery::COLUMNAR_BATCH) {
+                firequery::RecordBatch* batch = arena.create<firequery::RecordBatch>();
+                RecordBatchBuilder builder(batch);
+                builder.reserve(chunk_records);
+                for (const auto& record : pending) {
+                    builder.add(record);
+                }
+                setBatchPayload(*batch, &chunk_resp);
+            } else {
+                chunk_resp.mutable_records()->Reserve(chunk_records);
+                for (const auto& record : pending) {
+                    convertToProto(record, chunk_resp.add_records());
+                }
+                chunk_resp.set_record_count(chunk_records);
+            }
+            pending.clear();
+
+            if (!pacer.pace(chunk_resp.ByteSizeLong(), chunk_records, &cancel)) {
+                arena.reset();
+                return false;
             }
 
-            if (!writer->Write(chunk_resp)) {
+            bool by_ref = ring.put(chunk_resp, &ring_ref, &cancel);
+            grpc::WriteOptions write_options = by_ref
+                ? grpc::WriteOptions().set_no_compression()
+                : compressor.nextWriteOptions(chunk_resp, chunk_resp.chunk_number());
+            auto write_start = std::chrono::steady_clock::now();
+            if (!writer->Write(by_ref ? ring_ref : chunk_resp, write_options)) {
                 std::cerr << "  [Worker " << config_.process_id << "] Failed to write chunk" << std::endl;
-                {
-                    std::lock_guard<std::mutex> lock(status_mutex_);
-                    // Metrics: failed to send worker chunk upstream
-                    metrics::log_event("WORKER_CHUNK_SEND_ERROR", request->request_id(), pending_requests_, 1, chunk_resp.chunk_number(), chunk_resp.records_size(), config_.process_id);
-                    pending_requests_--;
-                    status_mgr_.updateProcessStatus(config_.process_id, pending_requests_, 1, completed_requests_);
-                }
-                return Status::CANCELLED;
+                // Metrics: failed to send worker chunk upstream
+                metrics::log_event("WORKER_CHUNK_SEND_ERROR", request->request_id(), pending_requests_, 1, chunk_resp.chunk_number(), chunk_records, config_.process_id);
+                write_failed = true;
+                arena.reset();
+                return false;
             }
 
+            auto write_time = std::chrono::steady_clock::now() - write_start;
+            if (!by_ref) compressor.recordWrite(write_time);
+            sizer.record(chunk_resp.ByteSizeLong(), chunk_records, write_time);
+
             // Metrics: worker chunk sent (only after successful write)
-            metrics::log_event("WORKER_CHUNK_SENT", request->request_id(), pending_requests_, 1, chunk_resp.chunk_number(), chunk_resp.records_size(), config_.process_id);
+            metrics::log_event("WORKER_CHUNK_SENT", request->request_id(), pending_requests_, 1, chunk_resp.chunk_number(), chunk_records, config_.process_id);
+            arena.reset();
 
             std::cout << "  [Worker " << config_.process_id << "] Sent chunk " << chunk_count - 1
-                      << " with " << chunk_resp.records_size() << " records" << std::endl;
+                      << " with " << chunk_records << " records" << std::endl;
+            return true;
+        };
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+
+        auto sink = [&](FireDataRecord&& record) {
+            pending.push_back(std::move(record));
+            if (pending.size() < static_cast<size_t>(sizer.next())) return true;
+            return send_pending();
+        };
+        size_t scanned = files.empty()
+            ? data_loader_.scanData(dates_to_process, original_query.pollutant_type(),
+                                    original_query.latitude_min(), original_query.latitude_max(),
+                                    original_query.longitude_min(), original_query.longitude_max(),
+                                    original_query.max_records(), &cancel, sink)
+            : data_loader_.scanFiles(files, original_query.pollutant_type(),
+                                     original_query.latitude_min(), original_query.latitude_max(),
+                                     original_query.longitude_min(), original_query.longitude_max(),
+                                     original_query.max_records(), &cancel, sink);
+        if (!pending.empty() && !write_failed && !cancel.cancelled()) {
+            send_pending();
+        }
+
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+
+        std::cout << "  [Worker " << config_.process_id << "] Scanned " << scanned
+                  << " records in " << duration.count() << "ms" << std::endl;
+
+        metrics::log_event("LOADED_RECORDS", request->request_id(), pending_requests_, 1, -1, scanned, "loaded by worker");
+        if (pacer.throttledChunks() > 0) {
+            metrics::log_event("PACING_THROTTLED", request->request_id(), pending_requests_, 1, pacer.throttledChunks(),
+                               static_cast<int>(pacer.throttledMs()), config_.process_id);
+        }
+
+        // The consumer must have taken every chunk before the ring goes away
+        if (!write_failed && !cancel.cancelled() && !ring.finish(&cancel)) {
+            std::cerr << "  [Worker " << config_.process_id << "] Consumer did not drain the chunk ring" << std::endl;
+        }
+        if (ring.chunks() > 0) {
+            metrics::log_event("SHM_CHUNKS", request->request_id(), pending_requests_, 1, ring.chunks(),
+                               static_cast<int>(ring.bytes() / 1024), "waits=" + std::to_string(ring.waits()));
+        }
 
-            // Simulate some processing time for realistic demonstration
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (write_failed) {
+            std::lock_guard<std::mutex> lock(status_mutex_);
+            pending_requests_--;
+            status_mgr_.updateProcessStatus(config_.process_id, pending_requests_, 1, completed_requests_);
+            return Status::CANCELLED;
+        }
+        if (cancel.cancelled()) {
+            return cancelled(request->request_id(), chunk_count);
         }
 
         std::cout << "[Worker " << config_.process_id << "] Delegation "
@@ -176,6 +291,48 @@ public:
         return Status::OK;
     }
 
+    Status GrantCredit(ServerContext* context,
+                       const CreditGrant* request,
+                       CreditAck* response) override {
+        response->set_accepted(CreditRegistry::instance().grant(
+            request->request_id(), request->consumer_process(), request->credit_stream(), request->chunks()));
+        return Status::OK;
+    }
+
+    Status GetPartitionMap(ServerContext* context,
+                           const PartitionMapRequest* request,
+                           PartitionMapResponse* response) override {
+        DataPartitioning partitioning = partitioning_.get();
+        auto* entry = response->add_entries();
+        entry->set_process_id(config_.process_id);
+        entry->set_role(config_.role);
+        entry->set_team(config_.team);
+        for (const auto& date : partitioning.owned_dates) {
+            entry->add_owned_dates(date);
+        }
+        for (const auto& date : partitioning.replica_dates) {
+            entry->add_replica_dates(date);
+        }
+        addDateCosts(data_loader_.scanCosts(), entry);
+        response->set_complete(true);
+        return Status::OK;
+    }
+
+    Status UpdatePartition(ServerContext* context,
+                           const PartitionUpdate* request,
+                           PartitionUpdateAck* response) override {
+        if (!request->process_id().empty() && request->process_id() != config_.process_id) {
+            return Status(grpc::StatusCode::NOT_FOUND, "No process " + request->process_id() + " here");
+        }
+        applyPartitionUpdate(config_, partitioning_, data_loader_, *request, response);
+        std::cout << "[Worker " << config_.process_id << "] Partition update from "
+                  << request->requesting_process() << ": "
+                  << (response->applied() ? "applied" : response->message()) << std::endl;
+        metrics::log_event("PARTITION_UPDATE", "", pending_requests_, 1, -1, response->owned_dates_size(),
+                           response->applied() ? "applied" : response->message());
+        return Status::OK;
+    }
+
     // Not used by workers
     Status QueryFire(ServerContext* context,
                     const QueryRequest* request,
@@ -186,10 +343,12 @@ public:
     Status CancelQuery(ServerContext* context,
                       const CancelRequest* request,
                       CancelResponse* response) override {
+        int found = CancellationRegistry::instance().cancel(request->request_id());
         std::cout << "[Worker " << config_.process_id << "] Cancel request for "
-                  << request->request_id() << std::endl;
+                  << request->request_id() << " (" << found << " in flight)" << std::endl;
         response->set_request_id(request->request_id());
-        response->set_cancelled(true);
+        response->set_cancelled(found > 0);
+        response->set_message(found > 0 ? "Query cancelled" : "Query not in flight");
         return Status::OK;
     }
 
@@ -197,20 +356,48 @@ private:
     ProcessConfig config_;
     StatusManager status_mgr_;
     FireDataLoader data_loader_;
+    LivePartitioning partitioning_;  // config's partitioning, as changed by UpdatePartition
+    std::unique_ptr<LoadSampler> load_sampler_;
+    TokenBucket process_pacing_;  // shared by every delegation stream of this worker
     int pending_requests_ = 0;
     int completed_requests_ = 0;
     std::mutex status_mutex_;
 
-    std::vector<std::string> selectDatesToProcess(const QueryRequest& query) {
-        std::vector<std::string> result;
+    // Stop a cancelled delegation: record it and release its pending slot
+    Status cancelled(const std::string& request_id, int chunks_sent) {
+        std::cout << "  [Worker " << config_.process_id << "] Delegation "
+                  << request_id << " cancelled after " << chunks_sent << " chunks" << std::endl;
+        std::lock_guard<std::mutex> lock(status_mutex_);
+        metrics::log_event("DELEGATION_CANCELLED", request_id, pending_requests_, 1, chunks_sent, -1, config_.process_id);
+        pending_requests_--;
+        status_mgr_.updateProcessStatus(config_.process_id, pending_requests_, 1, completed_requests_);
+        return Status::CANCELLED;
+    }
 
-        for (const auto& date : config_.data_partitioning.owned_dates) {
-            if (date >= query.date_start() && date <= query.date_end()) {
-                result.push_back(date);
+    // A work-stealing task's files must be data files of dates we hold (any
+    // date when the team shares storage). Returns what is wrong, or "".
+    std::string checkTargetFiles(const DelegationRequest& request) {
+        if (request.target_files().empty()) return "";
+        DataPartitioning partitioning = partitioning_.get();
+        for (const auto& file : request.target_files()) {
+            std::string date = data_loader_.dataFileDate(file);
+            if (date.empty()) return "not a data file: " + file;
+            if (config_.work_stealing_config.shared_storage) continue;
+            auto holds = [&date](const std::vector<std::string>& dates) {
+                return std::find(dates.begin(), dates.end(), date) != dates.end();
+            };
+            if (!holds(partitioning.owned_dates) && !holds(partitioning.replica_dates)) {
+                return "date " + date + " of " + file + " is not held by " + config_.process_id;
             }
         }
+        return "";
+    }
 
-        return result;
+    // Owned dates in the query range, restricted to target_dates when the caller lists them
+    std::vector<std::string> selectDatesToProcess(const QueryRequest& query,
+                                                  const DelegationRequest& request) {
+        return selectServedDates(partitioning_.get(), query.date_start(), query.date_end(),
+                                 request.target_dates());
     }
 
     void convertToProto(const FireDataRecord& src, FireRecord* dest) {
@@ -10,6 +10,7 @@ import grpc
 import time
 import csv
 import os
+import threading
 from concurrent import futures
 from pathlib import Path
 
@@ -22,9 +23,89 @@ import fire_query_pb2
 import fire_query_pb2_grpc
 
 
+# Rows parsed between cancellation checks
+CANCEL_CHECK_ROWS = 1024
+
+# How often a producer waiting for credit re-checks cancellation (seconds)
+CREDIT_WAIT_SLICE = 0.02
+
+
+class CreditGate:
+    """Chunks this process may still send on one credit-controlled delegation stream"""
+
+    def __init__(self, initial):
+        self.credit = initial
+        self.cond = threading.Condition()
+
+    def grant(self, chunks):
+        with self.cond:
+            self.credit += chunks
+            self.cond.notify_all()
+
+    def acquire(self, cancel):
+        """Take one credit, waiting while none is available; False if cancelled"""
+        with self.cond:
+            while self.credit <= 0:
+                if cancel.is_set():
+                    return False
+                self.cond.wait(CREDIT_WAIT_SLICE)
+            self.credit -= 1
+            return True
+
+
+class TokenBucket:
+    """Refilled at `rate` units per second, holding at most `burst`; rate <= 0 is unlimited.
+    Reservations may put the bucket in debt, which the caller waits off."""
+
+    def __init__(self, rate, burst=0):
+        self.rate = rate
+        self.burst = burst if burst > 0 else rate
+        self.tokens = self.burst
+        self.last = time.monotonic()
+        self.lock = threading.Lock()
+
+    def unlimited(self):
+        return self.rate <= 0
+
+    def reserve(self, units):
+        """Take `units` now; returns how long to wait before using them (seconds)"""
+        if self.unlimited():
+            return 0.0
+        with self.lock:
+            now = time.monotonic()
+            self.tokens = min(self.burst, self.tokens + self.rate * (now - self.last))
+            self.last = now
+            self.tokens -= units
+            return 0.0 if self.tokens >= 0 else -self.tokens / self.rate
+
+
+class StreamPacer:
+    """Paces one outgoing stream against its own bucket and the process-wide one"""
+
+    def __init__(self, pacing, process_bucket):
+        self.by_records = pacing.get('pacing_unit') == 'records'
+        self.stream = TokenBucket(pacing.get('pacing_stream_rate', 0), pacing.get('pacing_burst', 0))
+        self.process = process_bucket
+        self.throttled = 0.0
+        self.throttled_chunks = 0
+
+    def pace(self, size_bytes, records, cancel):
+        """Wait until a chunk of this size may go; False if cancelled while waiting"""
+        if self.stream.unlimited() and self.process.unlimited():
+            return True
+        units = records if self.by_records else size_bytes
+        wait = max(self.stream.reserve(units), self.process.reserve(units))
+        if wait <= 0:
+            return True
+        self.throttled += wait
+        self.throttled_chunks += 1
+        return not cancel.wait(wait)
+
+
 class WorkerServiceImpl(fire_query_pb2_grpc.FireQueryServiceServicer):
-    def __init__(self, config):
+    def __init__(self, config, config_file=None):
         self.config = config
+        self.config_file = config_file
         self.process_id = config['process_id']
         self.team = config['team']
 
@@ -36,11 +117,28 @@ class WorkerServiceImpl(fire_query_pb2_grpc.FireQueryServiceServicer):
         else:
             self.data_path = config['data_path']
 
-        self.owned_dates = config['data_partitioning']['owned_dates']
-        self.chunk_size = config['chunk_config']['default_chunk_size']
+        # Changed at runtime by UpdatePartition; both lists are replaced, never mutated
+        self.owned_dates = sorted(config['data_partitioning']['owned_dates'])
+        self.replica_dates = sorted(config['data_partitioning'].get('replica_dates', []))
+        self.partition_lock = threading.Lock()
+        # Per-date scan cost: date -> [files, rows, bytes, scan_us]
+        self.scan_costs = {}
+        self.scan_costs_lock = threading.Lock()
+        self.chunk_config = config['chunk_config']
+        # Stream pacing (optional, unlimited by default); the process bucket is shared by all streams
+        self.pacing = config.get('pacing', {})
+        self.process_pacing = TokenBucket(self.pacing.get('pacing_process_rate', 0), self.pacing.get('pacing_burst', 0))
         self.pending_requests = 0
         self.completed_requests = 0
 
+        # In-flight delegations: request_id -> cancellation events (one per stream)
+        self.in_flight = {}
+        self.in_flight_lock = threading.Lock()
+
+        # Credit-controlled streams: (request_id, consumer, credit_stream) -> CreditGate
+        self.credit_gates = {}
+        self.credit_lock = threading.Lock()
+
         print(f"Worker Process {self.process_id} (Team {self.team}) starting...")
         print(f"Listening on {config['listen_host']}:{config['listen_port']}")
         print(f"Data partition: {' '.join(self.owned_dates)}")
@@ -67,6 +165,11 @@ class WorkerServiceImpl(fire_query_pb2_grpc.FireQueryServiceServicer):
         """Handle delegated query from team leader"""
         print(f"\n[Worker {self.process_id}] Received delegation {request.request_id} from {request.delegating_process}")
 
+        bad_file = self._check_target_files(request.target_files)
+        if bad_file:
+            print(f"  [Worker {self.process_id}] Refusing task: {bad_file}")
+            context.abort(grpc.StatusCode.INVALID_ARGUMENT, bad_file)
+
         self.pending_requests += 1
 
         # Metrics: received delegation
@@ -76,71 +179,162 @@ class WorkerServiceImpl(fire_query_pb2_grpc.FireQueryServiceServicer):
         original_query = fire_query_pb2.QueryRequest()
         original_query.ParseFromString(request.original_query)
 
-        # Determine dates to process
-        dates_to_process = self._select_dates_to_process(original_query)
-        print(f"  [Worker {self.process_id}] Processing {len(dates_to_process)} dates")
+        # Response compression requested by the delegating edge. Python's API can't
+        # toggle compression per chunk from measurements, so adaptive behaves as gzip.
+        if request.response_compression in (fire_query_pb2.COMPRESSION_GZIP, fire_query_pb2.COMPRESSION_ADAPTIVE):
+            context.set_compression(grpc.Compression.Gzip)
+        elif request.response_compression == fire_query_pb2.COMPRESSION_DEFLATE:
+            context.set_compression(grpc.Compression.Deflate)
+
+        # A work-stealing task names its files; otherwise scan the dates we serve
+        files = list(request.target_files)
+        dates_to_process = [] if files else self._select_dates_to_process(original_query, request.target_dates)
+        if files:
+            print(f"  [Worker {self.process_id}] Processing {len(files)} files")
+        else:
+            print(f"  [Worker {self.process_id}] Processing {len(dates_to_process)} dates")
 
-        if not dates_to_process:
+        if not dates_to_process and not files:
             print(f"  [Worker {self.process_id}] No matching dates in partition")
             self.pending_requests -= 1
             self.completed_requests += 1
             return
 
-        # Load and process data
+        # Set by CancelQuery for this request id or when the caller drops the stream
+        cancel = threading.Event()
+        context.add_callback(cancel.set)
+        with self.in_flight_lock:
+            self.in_flight.setdefault(request.request_id, []).append(cancel)
+        try:
+            yield from self._stream_records(request, original_query, dates_to_process, files, cancel)
+        except GeneratorExit:
+            # gRPC closes the generator when the caller cancels the stream
+            print(f"  [Worker {self.process_id}] Delegation {request.request_id} cancelled by caller")
+            self._log_event('DELEGATION_CANCELLED', request.request_id, self.pending_requests, 1, -1, -1, self.process_id)
+            raise
+        finally:
+            with self.in_flight_lock:
+                events = self.in_flight.get(request.request_id, [])
+                if cancel in events:
+                    events.remove(cancel)
+                if not events:
+                    self.in_flight.pop(request.request_id, None)
+            self.pending_requests -= 1
+
+    def _stream_records(self, request, original_query, dates_to_process, files, cancel):
+        """Scan the partition and yield chunks as records arrive, until done or cancelled"""
+        # Credit flow control: wait for credit before each chunk, which also pauses the scan
+        gate = None
+        credit_key = (request.request_id, request.delegating_process, request.credit_stream)
+        if request.initial_credit > 0:
+            gate = CreditGate(request.initial_credit)
+            with self.credit_lock:
+                self.credit_gates[credit_key] = gate
+
+        chunk_size = self._resolve_chunk_size(original_query.chunk_size)
+        pacer = StreamPacer(self.pacing, self.process_pacing)
+        chunk_count = 0
+        scanned = 0
+        pending = []
+        stopped = False
         start_time = time.time()
-        records = self._load_data(
-            dates_to_process,
-            original_query.pollutant_type,
-            original_query.latitude_min,
-            original_query.latitude_max,
-            original_query.longitude_min,
-            original_query.longitude_max,
-            original_query.max_records
-        )
-        duration = (time.time() - start_time) * 1000  # Convert to ms
+        try:
+            for file_records in self._scan_data(
+                    dates_to_process,
+                    original_query.pollutant_type,
+                    original_query.latitude_min,
+                    original_query.latitude_max,
+                    original_query.longitude_min,
+                    original_query.longitude_max,
+                    original_query.max_records,
+                    cancel,
+                    files):
+                scanned += len(file_records)
+                pending.extend(file_records)
+                # Send full chunks (client's chunk size, clamped to our bounds); the remainder waits for the next file
+                while len(pending) >= chunk_size and not stopped:
+                    chunk_records, pending = pending[:chunk_size], pending[chunk_size:]
+                    if (yield from self._send_chunk(request, original_query, chunk_records, chunk_count, gate, pacer, cancel)):
+                        chunk_count += 1
+                    else:
+                        stopped = True
+                if stopped or cancel.is_set():
+                    break
+
+            if pending and not stopped and not cancel.is_set():
+                if (yield from self._send_chunk(request, original_query, pending, chunk_count, gate, pacer, cancel)):
+                    chunk_count += 1
+        finally:
+            if gate is not None:
+                with self.credit_lock:
+                    # Another stream may have registered under the same key since
+                    if self.credit_gates.get(credit_key) is gate:
+                        del self.credit_gates[credit_key]
 
-        print(f"  [Worker {self.process_id}] Loaded {len(records)} records in {duration:.0f}ms")
+        duration = (time.time() - start_time) * 1000  # Convert to ms
+        print(f"  [Worker {self.process_id}] Scanned {scanned} records in {duration:.0f}ms")
 
         # Metrics: loaded records
-        self._log_event('LOADED_RECORDS', request.request_id, self.pending_requests, 1, -1, len(records), 'loaded by python worker')
-        # Send records in chunks
-        chunk_count = 0
-        for i in range(0, len(records), self.chunk_size):
-            chunk_end = min(i + self.chunk_size, len(records))
-            chunk_records = records[i:chunk_end]
+        self._log_event('LOADED_RECORDS', request.request_id, self.pending_requests, 1, -1, scanned, 'loaded by python worker')
+        if pacer.throttled_chunks:
+            self._log_event('PACING_THROTTLED', request.request_id, self.pending_requests, 1,
+                            pacer.throttled_chunks, int(pacer.throttled * 1000), self.process_id)
+
+        if cancel.is_set():
+            print(f"  [Worker {self.process_id}] Delegation {request.request_id} cancelled after {chunk_count} chunks")
+            self._log_event('DELEGATION_CANCELLED', request.request_id, self.pending_requests, 1, chunk_count, -1, self.process_id)
+            return
+
+        print(f"[Worker {self.process_id}] Delegation {request.request_id} complete. Sent {chunk_count} chunks")
+        self.completed_requests += 1
 
-            response = fire_query_pb2.DelegationResponse()
-            response.request_id = request.request_id
-            response.chunk_number = chunk_count
-            response.is_final = False
-            response.responding_process = self.process_id
+    def _send_chunk(self, request, original_query, chunk_records, chunk_number, gate, pacer, cancel):
+        """Yield one chunk once credit allows; returns False if the stream should stop"""
+        if gate is not None and not gate.acquire(cancel):
+            return False
 
-            # Add records to response
+        response = fire_query_pb2.DelegationResponse()
+        response.request_id = request.request_id
+        response.chunk_number = chunk_number
+        response.is_final = False
+        response.responding_process = self.process_id
+
+        # Add records to response
+        if original_query.record_format == fire_query_pb2.COLUMNAR_BATCH:
+            batch = fire_query_pb2.RecordBatch()
+            self._populate_record_batch(batch, chunk_records)
+            response.batch_payload = batch.SerializeToString()
+        else:
             for record_data in chunk_records:
                 record = response.records.add()
                 self._populate_fire_record(record, record_data)
+        response.record_count = len(chunk_records)
 
-            try:
-                yield response
+        if not pacer.pace(response.ByteSize(), len(chunk_records), cancel):
+            return False
 
-                # Metrics: chunk sent (best-effort: generator yielded)
-                self._log_event('WORKER_CHUNK_SENT', request.request_id, self.pending_requests, 1, chunk_count, len(chunk_records), self.process_id)
+        try:
+            yield response
 
-                print(f"  [Worker {self.process_id}] Sent chunk {chunk_count} with {len(chunk_records)} records")
-                chunk_count += 1
-            except Exception as e:
-                # If sending fails (client disconnect or other), log and stop
-                self._log_event('WORKER_CHUNK_SEND_ERROR', request.request_id, self.pending_requests, 1, chunk_count, len(chunk_records), str(e))
-                print(f"  [Worker {self.process_id}] Error sending chunk {chunk_count}: {e}")
-                break
+            # Metrics: chunk sent (best-effort: generator yielded)
+            self._log_event('WORKER_CHUNK_SENT', request.request_id, self.pending_requests, 1, chunk_number, len(chunk_records), self.process_id)
 
-            # Simulate processing time
-            time.sleep(0.05)
+            print(f"  [Worker {self.process_id}] Sent chunk {chunk_number} with {len(chunk_records)} records")
+        except Exception as e:
+            # If sending fails (client disconnect or other), log and stop
+            self._log_event('WORKER_CHUNK_SEND_ERROR', request.request_id, self.pending_requests, 1, chunk_number, len(chunk_records), str(e))
+            print(f"  [Worker {self.process_id}] Error sending chunk {chunk_number}: {e}")
+            return False
 
-        print(f"[Worker {self.process_id}] Delegation {request.request_id} complete. Sent {chunk_count} chunks")
+        return not cancel.is_set()
 
-        self.pending_requests -= 1
-        self.completed_requests += 1
+    def GrantCredit(self, request, context):
+        """Credit returned by the consumer of one of our delegation streams"""
+        with self.credit_lock:
+            gate = self.credit_gates.get((request.request_id, request.consumer_process, request.credit_stream))
+        if gate is not None:
+            gate.grant(request.chunks)
+        return fire_query_pb2.CreditAck(accepted=gate is not None)
 
     def HealthCheck(self, request, context):
         """Health check endpoint"""
@@ -153,62 +347,178 @@ class WorkerServiceImpl(fire_query_pb2_grpc.FireQueryServiceServicer):
 
     def CancelQuery(self, request, context):
         """Handle query cancellation"""
-        print(f"[Worker {self.process_id}] Cancel request for {request.request_id}")
+        with self.in_flight_lock:
+            events = list(self.in_flight.get(request.request_id, []))
+        for event in events:
+            event.set()
+        print(f"[Worker {self.process_id}] Cancel request for {request.request_id} ({len(events)} in flight)")
         response = fire_query_pb2.CancelResponse()
         response.request_id = request.request_id
-        response.cancelled = True
+        response.cancelled = bool(events)
+        response.message = "Query cancelled" if events else "Query not in flight"
+        return response
+
+    def GetPartitionMap(self, request, context):
+        """Report this worker's owned and replica dates"""
+        response = fire_query_pb2.PartitionMapResponse()
+        entry = response.entries.add()
+        entry.process_id = self.process_id
+        entry.role = self.config.get('role', 'worker')
+        entry.team = self.team
+        owned_dates, replica_dates = self._partition()
+        entry.owned_dates.extend(owned_dates)
+        entry.replica_dates.extend(replica_dates)
+        with self.scan_costs_lock:
+            costs = sorted(self.scan_costs.items())
+        for date, (files, rows, size, scan_us) in costs:
+            entry.date_costs.add(date=date, files=files, rows=rows, bytes=size, scan_us=scan_us)
+        response.complete = True
+        return response
+
+    def UpdatePartition(self, request, context):
+        """Change the dates this worker owns or replicates; added dates must be stored here"""
+        response = fire_query_pb2.PartitionUpdateAck()
+        if request.process_id and request.process_id != self.process_id:
+            context.abort(grpc.StatusCode.NOT_FOUND, f"No process {request.process_id} here")
+
+        base = None
+        if request.reload:
+            try:
+                base = load_config(self.config_file)['data_partitioning']
+            except Exception as e:
+                response.applied = False
+                response.message = str(e)
+                return response
+
+        missing = [date for date in list(request.add_owned) + list(request.add_replica)
+                   if not list(Path(self.data_path, date).glob('*.csv'))]
+        if missing:
+            response.applied = False
+            response.message = f"not stored at {self.process_id}: {' '.join(missing)}"
+        else:
+            def edit(dates, add, remove):
+                return sorted((set(dates) - set(remove)) | set(add))
+            with self.partition_lock:
+                owned = base['owned_dates'] if base else self.owned_dates
+                replicas = base.get('replica_dates', []) if base else self.replica_dates
+                self.owned_dates = edit(owned, request.add_owned, request.remove_owned)
+                self.replica_dates = edit(replicas, request.add_replica, request.remove_replica)
+                response.owned_dates.extend(self.owned_dates)
+                response.replica_dates.extend(self.replica_dates)
+            response.applied = True
+
+        print(f"[Worker {self.process_id}] Partition update from {request.requesting_process}: "
+              f"{'applied' if response.applied else response.message}")
+        self._log_event("PARTITION_UPDATE", "", self.pending_requests, 1, -1, len(response.owned_dates),
+                        "applied" if response.applied else response.message)
         return response
 
+    def _partition(self):
+        with self.partition_lock:
+            return self.owned_dates, self.replica_dates
+
     def QueryFire(self, request, context):
         """Not implemented for workers"""
         context.set_code(grpc.StatusCode.UNIMPLEMENTED)
         context.set_details("Workers don't accept direct queries")
         return fire_query_pb2.QueryResponse()
 
-    def _select_dates_to_process(self, query):
-        """Select dates that match query range and are owned by this worker"""
+    def _resolve_chunk_size(self, requested):
+        """Requested chunk size (or the default) clamped to [min_chunk_size, max_chunk_size]"""
+        size = requested if requested > 0 else self.chunk_config['default_chunk_size']
+        if self.chunk_config.get('min_chunk_size', 0) > 0:
+            size = max(size, self.chunk_config['min_chunk_size'])
+        if self.chunk_config.get('max_chunk_size', 0) > 0:
+            size = min(size, self.chunk_config['max_chunk_size'])
+        return max(size, 1)
+
+    def _select_dates_to_process(self, query, target_dates=()):
+        """Select dates that match query range and are owned by this worker.
+        When the caller lists target_dates, only those are served, including
+        dates this worker holds as a replica."""
+        targets = set(target_dates)
+        owned_dates, replica_dates = self._partition()
+        candidates = owned_dates + (replica_dates if targets else [])
         result = []
-        for date in self.owned_dates:
-            if query.date_start <= date <= query.date_end:
+        for date in candidates:
+            if targets and date not in targets:
+                continue
+            if query.date_start <= date <= query.date_end and date not in result:
                 result.append(date)
         return result
 
-    def _load_data(self, dates, pollutant_filter, lat_min, lat_max, lon_min, lon_max, max_records):
-        """Load fire data from CSV files"""
-        results = []
-
+    def _check_target_files(self, files):
+        """A work-stealing task's files must be "<date>/<name>.csv" inside the data path, of dates
+        we hold (any date when the team shares storage). Returns what is wrong, or ''"""
+        if not files:
+            return ''
+        owned_dates, replica_dates = self._partition()
+        root = os.path.realpath(self.data_path)
+        for file in files:
+            parts = file.split('/')
+            if (os.path.isabs(file) or len(parts) != 2 or not file.endswith('.csv')
+                    or any(part in ('', '.', '..') for part in parts)
+                    or os.path.commonpath([root, os.path.realpath(os.path.join(root, file))]) != root):
+                return f"not a data file: {file}"
+            if not self.config.get('shared_storage', False) and parts[0] not in owned_dates + replica_dates:
+                return f"date {parts[0]} of {file} is not held by {self.process_id}"
+        return ''
+
+    def _csv_paths(self, dates, files=()):
+        """CSV files to scan: a work-stealing task's files, else every file of the dates"""
+        if files:
+            for file in files:
+                yield os.path.join(self.data_path, file)
+            return
         for date in dates:
             date_dir = os.path.join(self.data_path, date)
             if not os.path.exists(date_dir):
                 print(f"Warning: Date directory not found: {date_dir}")
                 continue
-
-            # Load all CSV files for this date
             for csv_file in Path(date_dir).glob('*.csv'):
-                records = self._load_csv(
-                    str(csv_file),
-                    pollutant_filter,
-                    lat_min, lat_max,
-                    lon_min, lon_max,
-                    max_records - len(results) if max_records > 0 else -1
-                )
-                results.extend(records)
-
-                if max_records > 0 and len(results) >= max_records:
-                    return results[:max_records]
+                yield str(csv_file)
 
-        return results
+    def _scan_data(self, dates, pollutant_filter, lat_min, lat_max, lon_min, lon_max, max_records, cancel=None, files=()):
+        """Yield the matching records of each CSV file in turn, stopping early once cancel is set"""
+        remaining = max_records if max_records > 0 else -1
 
-    def _load_csv(self, csv_path, pollutant_filter, lat_min, lat_max, lon_min, lon_max, max_records):
+        for csv_path in self._csv_paths(dates, files):
+            if cancel is not None and cancel.is_set():
+                return
+            if not os.path.exists(csv_path):
+                print(f"Warning: Data file not found: {csv_path}")
+                continue
+            records = self._load_csv(
+                csv_path,
+                pollutant_filter,
+                lat_min, lat_max,
+                lon_min, lon_max,
+                remaining,
+                cancel
+            )
+            if records:
+                yield records
+
+            if remaining > 0:
+                remaining -= len(records)
+                if remaining <= 0:
+                    return
+
+    def _load_csv(self, csv_path, pollutant_filter, lat_min, lat_max, lon_min, lon_max, max_records, cancel=None):
         """Load and parse a single CSV file"""
         results = []
+        started = time.perf_counter()
+        rows = 0
 
         try:
             with open(csv_path, 'r') as f:
                 reader = csv.reader(f, quotechar='"')
-                for row in reader:
+                for row_number, row in enumerate(reader, 1):
+                    rows = row_number
                     if max_records > 0 and len(results) >= max_records:
                         break
+                    if cancel is not None and row_number % CANCEL_CHECK_ROWS == 0 and cancel.is_set():
+                        break
 
                     if len(row) < 13:
                         continue
@@ -253,9 +563,21 @@ class WorkerServiceImpl(fire_query_pb2_grpc.FireQueryServiceServicer):
 
         except FileNotFoundError:
             print(f"Warning: CSV file not found: {csv_path}")
+            return results
 
+        self._record_scan_cost(csv_path, rows, int((time.perf_counter() - started) * 1e6))
         return results
 
+    def _record_scan_cost(self, csv_path, rows, scan_us):
+        date = os.path.basename(os.path.dirname(csv_path))
+        size = os.path.getsize(csv_path)
+        with self.scan_costs_lock:
+            cost = self.scan_costs.setdefault(date, [0, 0, 0, 0])
+            cost[0] += 1
+            cost[1] += rows
+            cost[2] += size
+            cost[3] += scan_us
+
     def _populate_fire_record(self, proto_record, data):
         """Convert Python dict to protobuf FireRecord"""
         proto_record.latitude = data['latitude']
@@ -273,6 +595,34 @@ class WorkerServiceImpl(fire_query_pb2_grpc.FireQueryServiceServicer):
         proto_record.full_site_id = data['full_site_id']
 
 
+    def _populate_record_batch(self, batch, records):
+        """Encode records as a columnar RecordBatch with dictionary-coded strings"""
+        dictionary = {}
+
+        def intern(value):
+            idx = dictionary.get(value)
+            if idx is None:
+                idx = len(dictionary)
+                dictionary[value] = idx
+                batch.dictionary.append(value)
+            return idx
+
+        batch.num_records = len(records)
+        batch.latitude.extend(r['latitude'] for r in records)
+        batch.longitude.extend(r['longitude'] for r in records)
+        batch.concentration.extend(r['concentration'] for r in records)
+        batch.raw_concentration.extend(r['raw_concentration'] for r in records)
+        batch.aqi.extend(r['aqi'] for r in records)
+        batch.aqi_category.extend(r['aqi_category'] for r in records)
+        batch.timestamp_idx.extend(intern(r['timestamp']) for r in records)
+        batch.pollutant_idx.extend(intern(r['pollutant']) for r in records)
+        batch.unit_idx.extend(intern(r['unit']) for r in records)
+        batch.site_name_idx.extend(intern(r['site_name']) for r in records)
+        batch.agency_idx.extend(intern(r['agency']) for r in records)
+        batch.site_id_idx.extend(intern(r['site_id']) for r in records)
+        batch.full_site_id_idx.extend(intern(r['full_site_id']) for r in records)
+
+
 def load_config(config_file):
     """Load configuration from JSON file"""
     with open(config_file, 'r') as f:
@@ -285,7 +635,7 @@ def serve(config_file):
 
     server = grpc.server(futures.ThreadPoolExecutor(max_workers=10))
     fire_query_pb2_grpc.add_FireQueryServiceServicer_to_server(
-        WorkerServiceImpl(config), server
+        WorkerServiceImpl(config, config_file), server
     )
 
     listen_addr = f"{config['listen_host']}:{config['listen_port']}"
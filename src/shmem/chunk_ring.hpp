@@ -0,0 +1,280 @@
+#ifndef CHUNK_RING_HPP
+#define CHUNK_RING_HPP
+
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "fire_query.pb.h"
+#include "../common/cancellation.hpp"
+#include "../common/config.hpp"
+#include "status_manager.hpp"
+
+// Ring a consumer asks for on a same-host edge; with its header the segment
+// stays under macOS's default 4 MB SHMMAX
+constexpr int kDefaultChunkRingBytes = (4 << 20) - 4096;
+constexpr uint32_t kChunkRingMagic = 0x474e5243;  // "CRNG"
+constexpr uint32_t kChunkRingLayout = 2;
+
+// A new shm_ring_stream id for a stream this process consumes
+inline uint64_t newChunkRingStream() {
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Whether an edge's host is this machine, so its delegation stream can pass
+// chunks through shared memory instead of the loopback socket
+inline bool isLocalHost(const std::string& host) {
+    if (host == "localhost" || host == "::1" || host == "0.0.0.0" || host.rfind("127.", 0) == 0) return true;
+    char name[256] = {0};
+    return gethostname(name, sizeof(name) - 1) == 0 && host == name;
+}
+
+// Ring size to ask an edge's producer for (0 = chunks come inline over gRPC)
+inline int chunkRingBytes(const EdgeConfig& edge) {
+    if (edge.transport == "shm") return kDefaultChunkRingBytes;
+    if (edge.transport == "auto" && isLocalHost(edge.host)) return kDefaultChunkRingBytes;
+    return 0;
+}
+
+// Whether a gRPC peer (ServerContext::peer(), e.g. "ipv6:%5B::1%5D:41234")
+// connected over loopback or a Unix socket, so it can attach to our segments
+inline bool isLocalPeer(const std::string& peer) {
+    for (const char* prefix : {"unix:", "ipv4:127.", "ipv6:[::1]", "ipv6:%5B::1%5D",
+                               "ipv6:[::ffff:127.", "ipv6:%5B::ffff:127."}) {
+        if (peer.rfind(prefix, 0) == 0) return true;
+    }
+    return false;
+}
+
+// Ring a producer creates for a consumer's shm_ring_bytes: none unless the
+// consumer is local, and never more than kDefaultChunkRingBytes
+inline int producerRingBytes(int requested, const std::string& peer) {
+    if (requested <= 0 || !isLocalPeer(peer)) return 0;
+    return std::min(requested, kDefaultChunkRingBytes);
+}
+
+// Start of a chunk ring segment, followed by `capacity` data bytes. stream is
+// the consumer's shm_ring_stream id, so it only touches the ring it asked
+// for. head and tail are byte counts since the stream began (position =
+// count % capacity): the producer publishes up to head, the consumer releases
+// up to tail. Each is written by one side only and sits on its own cache line.
+struct ChunkRingHeader {
+    uint32_t magic;
+    uint32_t layout;
+    uint64_t stream;
+    uint32_t capacity;
+    alignas(kCacheLineSize) std::atomic<uint64_t> head;
+    alignas(kCacheLineSize) std::atomic<uint64_t> tail;
+    alignas(kCacheLineSize) std::atomic<uint32_t> consumer_attached;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring cursors are shared between processes");
+
+// Producer end of one delegation stream's chunk ring. The segment is private
+// (IPC_PRIVATE, owner only); its id travels in every chunk reference. A chunk
+// is serialized straight into the ring and only its reference goes over gRPC.
+// Chunks are contiguous: one that would wrap starts at the beginning instead,
+// and the skipped end is released with it. Once the consumer has attached,
+// the segment is marked for removal (by whichever side gets there first), so
+// it goes away with the last of the two processes even if either dies. A ring of 0 bytes (or one that could not be
+// created) takes no chunks and everything goes inline.
+class ChunkRingWriter {
+public:
+    // How often a producer waiting for ring space re-checks it and cancellation
+    static constexpr auto kSpaceCheckInterval = std::chrono::microseconds(200);
+    // How long finish() waits for the consumer to take the last chunks
+    static constexpr auto kDrainTimeout = std::chrono::seconds(30);
+
+    ChunkRingWriter(int capacity, uint64_t stream) {
+        if (capacity <= 0) return;
+        shmid_ = shmget(IPC_PRIVATE, sizeof(ChunkRingHeader) + static_cast<size_t>(capacity), IPC_CREAT | 0600);
+        if (shmid_ < 0) {
+            // Typically a segment size or count limit (SHMMAX, SHMALL, SHMMNI); logged once per process
+            static std::atomic<bool> warned{false};
+            if (!warned.exchange(true)) {
+                std::cerr << "Warning: Could not create a " << capacity << "-byte chunk ring ("
+                          << strerror(errno) << "), sending chunks inline" << std::endl;
+            }
+            return;
+        }
+        void* segment = shmat(shmid_, NULL, 0);
+        if (segment == (void*)-1) {
+            shmctl(shmid_, IPC_RMID, NULL);
+            shmid_ = -1;
+            return;
+        }
+        header_ = new (segment) ChunkRingHeader();
+        header_->magic = kChunkRingMagic;
+        header_->layout = kChunkRingLayout;
+        header_->stream = stream;
+        header_->capacity = static_cast<uint32_t>(capacity);
+        header_->head.store(0, std::memory_order_relaxed);
+        header_->tail.store(0, std::memory_order_relaxed);
+        header_->consumer_attached.store(0, std::memory_order_release);
+        data_ = reinterpret_cast<char*>(header_ + 1);
+    }
+
+    ~ChunkRingWriter() {
+        if (!header_) return;
+        if (!removed_) shmctl(shmid_, IPC_RMID, NULL);
+        shmdt(header_);
+    }
+
+    ChunkRingWriter(const ChunkRingWriter&) = delete;
+    ChunkRingWriter& operator=(const ChunkRingWriter&) = delete;
+
+    bool enabled() const { return header_ != nullptr; }
+
+    // Put chunk in the ring and describe it in ref (cleared first). False if it
+    // has to go inline instead: no ring, larger than half the ring, or cancelled
+    // while waiting for the consumer to free space.
+    bool put(const firequery::DelegationResponse& chunk, firequery::DelegationResponse* ref,
+             const CancellationToken* cancel) {
+        if (!header_) return false;
+        size_t size = chunk.ByteSizeLong();
+        uint64_t capacity = header_->capacity;
+        if (size == 0 || size > capacity / 2) return false;
+
+        uint64_t at = head_;
+        uint64_t offset = at % capacity;
+        if (offset + size > capacity) at += capacity - offset;
+        uint64_t end = at + size;
+        while (end - header_->tail.load(std::memory_order_acquire) > capacity) {
+            if (cancel && cancel->cancelled()) return false;
+            waits_++;
+            std::this_thread::sleep_for(kSpaceCheckInterval);
+        }
+
+        chunk.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(data_ + at % capacity));
+        head_ = end;
+        header_->head.store(end, std::memory_order_release);
+        removeOnceAttached();
+
+        ref->Clear();
+        ref->set_shm_segment(shmid_);
+        ref->set_shm_offset(at);
+        ref->set_shm_length(static_cast<uint32_t>(size));
+        chunks_++;
+        bytes_ += static_cast<long long>(size);
+        return true;
+    }
+
+    // Wait until the consumer has taken every chunk, so the segment outlives
+    // its last reference. False on cancellation or timeout.
+    bool finish(const CancellationToken* cancel) {
+        if (!header_ || chunks_ == 0) return true;
+        auto deadline = std::chrono::steady_clock::now() + kDrainTimeout;
+        while (header_->tail.load(std::memory_order_acquire) != head_) {
+            if ((cancel && cancel->cancelled()) || std::chrono::steady_clock::now() > deadline) return false;
+            std::this_thread::sleep_for(kSpaceCheckInterval);
+        }
+        removeOnceAttached();
+        return true;
+    }
+
+    int chunks() const { return chunks_; }
+    long long bytes() const { return bytes_; }
+    int waits() const { return waits_; }
+
+private:
+    int shmid_ = -1;
+    ChunkRingHeader* header_ = nullptr;
+    char* data_ = nullptr;
+    uint64_t head_ = 0;
+    bool removed_ = false;
+    int chunks_ = 0;
+    long long bytes_ = 0;
+    int waits_ = 0;
+
+    void removeOnceAttached() {
+        if (removed_ || header_->consumer_attached.load(std::memory_order_acquire) == 0) return;
+        shmctl(shmid_, IPC_RMID, NULL);
+        removed_ = true;
+    }
+};
+
+// Consumer end: turns chunk references read from a delegation stream back
+// into chunks, releasing their ring space as it goes. References have to be
+// resolved in stream order. Inline chunks pass through untouched.
+class ChunkRingReader {
+public:
+    // stream: the shm_ring_stream id this stream's DelegationRequest carried
+    explicit ChunkRingReader(uint64_t stream) : stream_(stream) {}
+    ~ChunkRingReader() { detach(); }
+
+    ChunkRingReader(const ChunkRingReader&) = delete;
+    ChunkRingReader& operator=(const ChunkRingReader&) = delete;
+
+    // Replace a reference with the chunk it points to. False if the reference
+    // does not point into a valid ring or at a parsable chunk.
+    bool resolve(firequery::DelegationResponse& chunk) {
+        if (chunk.shm_length() == 0) return true;
+        if (chunk.shm_segment() != shmid_ && !attach(chunk.shm_segment())) return false;
+
+        uint64_t capacity = header_->capacity;
+        uint64_t at = chunk.shm_offset();
+        uint64_t end = at + chunk.shm_length();
+        if (at < header_->tail.load(std::memory_order_relaxed) ||
+            end > header_->head.load(std::memory_order_acquire) ||
+            at % capacity + chunk.shm_length() > capacity) {
+            return false;
+        }
+        if (!chunk.ParseFromArray(data_ + at % capacity, static_cast<int>(end - at))) return false;
+        header_->tail.store(end, std::memory_order_release);
+        chunks_++;
+        return true;
+    }
+
+    int chunks() const { return chunks_; }
+
+private:
+    uint64_t stream_;
+    int shmid_ = -1;
+    ChunkRingHeader* header_ = nullptr;
+    const char* data_ = nullptr;
+    int chunks_ = 0;
+
+    // Nothing is written to a segment (or removed) before it proves to be
+    // the ring of this stream
+    bool attach(int shmid) {
+        detach();
+        if (stream_ == 0) return false;
+        struct shmid_ds info;
+        if (shmctl(shmid, IPC_STAT, &info) != 0 || info.shm_segsz < sizeof(ChunkRingHeader)) return false;
+        void* segment = shmat(shmid, NULL, 0);
+        if (segment == (void*)-1) return false;
+        auto* header = static_cast<ChunkRingHeader*>(segment);
+        if (header->magic != kChunkRingMagic || header->layout != kChunkRingLayout || header->stream != stream_ ||
+            info.shm_segsz < sizeof(ChunkRingHeader) + header->capacity || header->capacity == 0) {
+            shmdt(segment);
+            return false;
+        }
+        shmid_ = shmid;
+        header_ = header;
+        data_ = reinterpret_cast<const char*>(header_ + 1);
+        header_->consumer_attached.store(1, std::memory_order_release);
+        // A producer that dies before its next put would otherwise leave the segment behind
+        shmctl(shmid, IPC_RMID, NULL);
+        return true;
+    }
+
+    void detach() {
+        if (header_) shmdt(header_);
+        header_ = nullptr;
+        data_ = nullptr;
+        shmid_ = -1;
+    }
+};
+
+#endif // CHUNK_RING_HPP
@@ -0,0 +1,127 @@
+#ifndef LOAD_SAMPLER_HPP
+#define LOAD_SAMPLER_HPP
+
+#ifdef __linux__
+#include <sched.h>
+#else
+#include <sys/resource.h>
+#endif
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "status_manager.hpp"
+
+// CPU time this process has used: utime + stime from /proc/self/stat on
+// Linux, getrusage elsewhere
+inline std::chrono::nanoseconds processCpuTime() {
+#ifndef __linux__
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return std::chrono::nanoseconds(0);
+    auto timeval_ns = [](const struct timeval& tv) {
+        return static_cast<long long>(tv.tv_sec) * 1000000000LL + static_cast<long long>(tv.tv_usec) * 1000LL;
+    };
+    return std::chrono::nanoseconds(timeval_ns(usage.ru_utime) + timeval_ns(usage.ru_stime));
+#else
+    std::ifstream stat("/proc/self/stat");
+    std::string line;
+    if (!std::getline(stat, line)) return std::chrono::nanoseconds(0);
+    // The command name may contain spaces; fields after it start at state (field 3)
+    size_t end_of_name = line.rfind(')');
+    if (end_of_name == std::string::npos) return std::chrono::nanoseconds(0);
+    std::istringstream fields(line.substr(end_of_name + 2));
+    std::string skip;
+    for (int field = 3; field < 14; ++field) fields >> skip;
+    long long utime = 0, stime = 0;
+    fields >> utime >> stime;
+    static const long ticks_per_second = sysconf(_SC_CLK_TCK);
+    return std::chrono::nanoseconds((utime + stime) * 1000000000LL / ticks_per_second);
+#endif
+}
+
+// CPUs this process may run on (its affinity mask on Linux, the online CPUs elsewhere)
+inline int availableCpus() {
+#ifdef __linux__
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) return std::max(1, CPU_COUNT(&set));
+#endif
+    return static_cast<int>(std::max(1L, sysconf(_SC_NPROCESSORS_ONLN)));
+}
+
+// Scans beyond the CPUs we may use are queued for a CPU
+inline int scansWaitingForCpu(int active_scans) {
+    static const int cpus = availableCpus();
+    return std::max(0, active_scans - cpus);
+}
+
+// Publishes this process's load into its status slot every interval: CPU
+// utilization over the interval (as a share of the CPUs it may use) plus the
+// server's own queue and scan gauges. Runs until destroyed.
+class LoadSampler {
+public:
+    struct Gauges {
+        int queue_depth = 0;
+        int64_t inflight_scan_bytes = 0;
+    };
+    using GaugeProbe = std::function<Gauges()>;
+
+    LoadSampler(StatusManager& status, std::string process_id, int interval_ms, GaugeProbe probe)
+        : status_(status), process_id_(std::move(process_id)),
+          interval_(std::chrono::milliseconds(interval_ms)), probe_(std::move(probe)),
+          cpus_(availableCpus()) {
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~LoadSampler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    LoadSampler(const LoadSampler&) = delete;
+    LoadSampler& operator=(const LoadSampler&) = delete;
+
+private:
+    StatusManager& status_;
+    const std::string process_id_;
+    const std::chrono::milliseconds interval_;
+    GaugeProbe probe_;
+    const int cpus_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+
+    void run() {
+        auto last_wall = std::chrono::steady_clock::now();
+        auto last_cpu = processCpuTime();
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!cv_.wait_for(lock, interval_, [this]() { return stopping_; })) {
+            lock.unlock();
+            auto wall = std::chrono::steady_clock::now();
+            auto cpu = processCpuTime();
+            double elapsed = std::chrono::duration<double>(wall - last_wall).count() * cpus_;
+            double usage = elapsed > 0 ? std::chrono::duration<double>(cpu - last_cpu).count() / elapsed : 0.0;
+            last_wall = wall;
+            last_cpu = cpu;
+
+            Gauges gauges = probe_();
+            status_.updateLoad(process_id_, std::min(1.0, std::max(0.0, usage)),
+                               gauges.queue_depth, gauges.inflight_scan_bytes);
+            lock.lock();
+        }
+    }
+};
+
+#endif // LOAD_SAMPLER_HPP
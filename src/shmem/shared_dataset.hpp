@@ -0,0 +1,362 @@
+#ifndef SHARED_DATASET_HPP
+#define SHARED_DATASET_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../common/cancellation.hpp"
+#include "../common/fire_record.hpp"
+
+constexpr uint32_t kDatasetMagic = 0x31534446;  // "FDS1"
+constexpr uint32_t kDatasetLayout = 1;          // bumped whenever the file layout changes
+
+// Start of a parsed CSV file. It is followed by `rows` DatasetRows and then
+// the string pool.
+struct DatasetFileHeader {
+    uint32_t magic;
+    uint32_t layout;
+    uint64_t rows;            // one per CSV line
+    uint64_t source_bytes;    // size of the CSV file it was parsed from
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+// One parsed CSV line. Strings are offsets into the file's string pool, where
+// each distinct string is stored once as a uint32 length and its bytes.
+struct DatasetRow {
+    double latitude;
+    double longitude;
+    double concentration;
+    double raw_concentration;
+    int32_t aqi;
+    int32_t aqi_category;
+    uint32_t timestamp;
+    uint32_t pollutant;
+    uint32_t unit;
+    uint32_t site_name;
+    uint32_t agency;
+    uint32_t site_id;
+    uint32_t full_site_id;
+    uint32_t reserved;
+};
+static_assert(sizeof(DatasetRow) == 72, "dataset rows are shared between processes and must not change size");
+
+// A parsed CSV file, mapped read-only
+class DatasetFile {
+public:
+    // Null if the file is missing or not a complete dataset file of our layout
+    static std::shared_ptr<const DatasetFile> map(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return nullptr;
+        struct stat info;
+        void* base = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(DatasetFileHeader)) {
+            base = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (base == MAP_FAILED) return nullptr;
+
+        std::shared_ptr<const DatasetFile> file(new DatasetFile(static_cast<const char*>(base),
+                                                                static_cast<size_t>(info.st_size)));
+        const DatasetFileHeader& header = *file->header_;
+        uint64_t rows_end = sizeof(DatasetFileHeader) + header.rows * sizeof(DatasetRow);
+        if (header.magic != kDatasetMagic || header.layout != kDatasetLayout ||
+            header.rows > file->size_ / sizeof(DatasetRow) || header.strings_offset < rows_end ||
+            header.strings_offset + header.strings_size > file->size_) {
+            return nullptr;
+        }
+        return file;
+    }
+
+    ~DatasetFile() { munmap(const_cast<char*>(base_), size_); }
+
+    DatasetFile(const DatasetFile&) = delete;
+    DatasetFile& operator=(const DatasetFile&) = delete;
+
+    uint64_t rows() const { return header_->rows; }
+    uint64_t sourceBytes() const { return header_->source_bytes; }
+    const DatasetRow& row(uint64_t index) const { return rows_[index]; }
+
+    // A pooled string ("" if the offset is out of the pool)
+    std::string_view text(uint32_t offset) const {
+        uint64_t pool = header_->strings_size;
+        if (offset + sizeof(uint32_t) > pool) return {};
+        uint32_t length;
+        memcpy(&length, strings_ + offset, sizeof(length));
+        if (offset + sizeof(uint32_t) + length > pool) return {};
+        return std::string_view(strings_ + offset + sizeof(uint32_t), length);
+    }
+
+    FireDataRecord record(uint64_t index) const {
+        const DatasetRow& row = rows_[index];
+        FireDataRecord record{};
+        record.latitude = row.latitude;
+        record.longitude = row.longitude;
+        record.timestamp = std::string(text(row.timestamp));
+        record.pollutant = std::string(text(row.pollutant));
+        record.concentration = row.concentration;
+        record.unit = std::string(text(row.unit));
+        record.raw_concentration = row.raw_concentration;
+        record.aqi = row.aqi;
+        record.aqi_category = row.aqi_category;
+        record.site_name = std::string(text(row.site_name));
+        record.agency = std::string(text(row.agency));
+        record.site_id = std::string(text(row.site_id));
+        record.full_site_id = std::string(text(row.full_site_id));
+        return record;
+    }
+
+private:
+    DatasetFile(const char* base, size_t size)
+        : base_(base), size_(size), header_(reinterpret_cast<const DatasetFileHeader*>(base)),
+          rows_(reinterpret_cast<const DatasetRow*>(base + sizeof(DatasetFileHeader))),
+          strings_(base + header_->strings_offset) {}
+
+    const char* base_;
+    size_t size_;
+    const DatasetFileHeader* header_;
+    const DatasetRow* rows_;
+    const char* strings_;
+};
+
+// Parsed CSV files shared by every server process of a user on a host. The
+// first process to scan a file parses it into a dataset file under the shared
+// directory (tmpfs at /dev/shm where there is one) and renames it into place
+// when complete; every process then maps it read-only, so the host holds one
+// parsed copy and a file parsed by any process is hot for all. A file's entry
+// is named after its path, size and modification time, so a changed CSV gets
+// a new entry and the old one is removed. While another process is building
+// an entry, or if it cannot be stored, the caller scans the CSV itself.
+// Entries are trusted once mapped, so the directory has to be ours and
+// writable by no one else.
+class SharedDataset {
+public:
+    using LineParser = std::function<FireDataRecord(const std::string& line)>;
+
+    // A build lock older than this was left by a process that died building
+    static constexpr auto kStaleBuild = std::chrono::seconds(60);
+    // After a failed build (e.g. the directory is full) no new entries are tried for this long
+    static constexpr auto kRetryAfterFailure = std::chrono::seconds(60);
+    // Lines parsed between cancellation checks while building an entry
+    static constexpr int kCancelCheckLines = 1024;
+
+    // dir: "" for the default location (one per user), "none" to disable
+    explicit SharedDataset(const std::string& dir) {
+        if (dir == "none") return;
+        std::error_code ec;
+        std::string path = dir;
+        if (path.empty()) {
+            std::string base = std::filesystem::is_directory("/dev/shm", ec)
+                ? std::string("/dev/shm")
+                : std::filesystem::temp_directory_path(ec).string();
+            path = base + "/fire-dataset-" + std::to_string(geteuid());
+        }
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+        ::mkdir(path.c_str(), 0700);
+        std::string problem = unusable(path);
+        if (!problem.empty()) {
+            std::cerr << "Warning: Shared dataset directory " << path << " " << problem
+                      << ", scanning CSV only" << std::endl;
+            return;
+        }
+        dir_ = path;
+    }
+
+    SharedDataset(const SharedDataset&) = delete;
+    SharedDataset& operator=(const SharedDataset&) = delete;
+
+    bool enabled() const { return !dir_.empty(); }
+    const std::string& dir() const { return dir_; }
+
+    // The parsed form of a CSV file, built with parse if no process has yet
+    // and may_build is set. A cancelled token stops a build. Null if the caller
+    // should scan the CSV itself.
+    std::shared_ptr<const DatasetFile> open(const std::string& csv_path, const LineParser& parse,
+                                            const CancellationToken* cancel, bool may_build = true) {
+        if (!enabled()) return nullptr;
+        std::error_code ec;
+        std::string source = std::filesystem::absolute(csv_path, ec).lexically_normal().string();
+        auto size = std::filesystem::file_size(source, ec);
+        if (ec) return nullptr;
+        auto modified = std::filesystem::last_write_time(source, ec).time_since_epoch().count();
+        if (ec) return nullptr;
+
+        std::string prefix = hex(fnv1a(source));
+        std::string version = std::to_string(size) + "/" + std::to_string(modified) + "/" + std::to_string(kDatasetLayout);
+        std::string name = prefix + "-" + hex(fnv1a(version)) + ".fds";
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = mapped_.find(name);
+            if (it != mapped_.end()) return it->second;
+        }
+
+        std::string path = dir_ + "/" + name;
+        auto file = DatasetFile::map(path);
+        if (!file && may_build && build(source, static_cast<uint64_t>(size), path, parse, cancel)) {
+            removeOtherVersions(prefix, name);
+            file = DatasetFile::map(path);
+        }
+        if (!file) return nullptr;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        return mapped_.emplace(name, std::move(file)).first->second;
+    }
+
+private:
+    std::string dir_;
+    std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<const DatasetFile>> mapped_;  // by entry name
+    std::chrono::steady_clock::time_point paused_until_;
+
+    static uint64_t fnv1a(const std::string& text) {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    static std::string hex(uint64_t value) {
+        char buffer[17];
+        snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(value));
+        return buffer;
+    }
+
+    // Why a directory can't hold entries ("" if it can)
+    static std::string unusable(const std::string& path) {
+        struct stat info;
+        if (lstat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) return "is not a directory";
+        if (info.st_uid != geteuid()) return "belongs to another user";
+        if (info.st_mode & (S_IWGRP | S_IWOTH)) return "is writable by other users";
+        return "";
+    }
+
+    // Parse source into path. False if another process is building it, or
+    // the build failed or was cancelled.
+    bool build(const std::string& source, uint64_t source_bytes, const std::string& path,
+               const LineParser& parse, const CancellationToken* cancel) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (std::chrono::steady_clock::now() < paused_until_) return false;
+        }
+
+        std::string lock_path = path + ".building";
+        int lock_fd = ::open(lock_path.c_str(), O_CREAT | O_EXCL | O_WRONLY, 0600);
+        if (lock_fd < 0) {
+            // Someone else is building it; clear the lock if its builder died long ago
+            std::error_code ec;
+            auto locked = std::filesystem::last_write_time(lock_path, ec);
+            if (!ec && std::filesystem::file_time_type::clock::now() - locked > kStaleBuild) {
+                std::filesystem::remove(lock_path, ec);
+            }
+            return false;
+        }
+        ::close(lock_fd);
+        std::error_code ec;
+        if (std::filesystem::exists(path, ec)) {
+            // Finished by another process since we looked
+            std::filesystem::remove(lock_path, ec);
+            return true;
+        }
+
+        std::string tmp_path = path + ".tmp." + std::to_string(getpid());
+        bool built = write(source, source_bytes, tmp_path, parse, cancel) &&
+                     rename(tmp_path.c_str(), path.c_str()) == 0;
+        if (!built && cancel && cancel->cancelled()) {
+            std::filesystem::remove(tmp_path, ec);
+        } else if (!built) {
+            std::filesystem::remove(tmp_path, ec);
+            std::lock_guard<std::mutex> lock(mutex_);
+            paused_until_ = std::chrono::steady_clock::now() + kRetryAfterFailure;
+            std::cerr << "Warning: Could not store parsed " << source << " in " << dir_ << std::endl;
+        }
+        std::filesystem::remove(lock_path, ec);
+        return built;
+    }
+
+    static bool write(const std::string& source, uint64_t source_bytes, const std::string& path,
+                      const LineParser& parse, const CancellationToken* cancel) {
+        std::ifstream in(source);
+        if (!in.is_open()) return false;
+
+        std::vector<DatasetRow> rows;
+        std::string pool;
+        std::unordered_map<std::string, uint32_t> interned;
+        auto intern = [&](const std::string& text) {
+            auto [it, inserted] = interned.try_emplace(text, static_cast<uint32_t>(pool.size()));
+            if (inserted) {
+                uint32_t length = static_cast<uint32_t>(text.size());
+                pool.append(reinterpret_cast<const char*>(&length), sizeof(length));
+                pool.append(text);
+            }
+            return it->second;
+        };
+
+        std::string line;
+        while (std::getline(in, line)) {
+            if (cancel && rows.size() % kCancelCheckLines == 0 && cancel->cancelled()) return false;
+            FireDataRecord record = parse(line);
+            DatasetRow row{};
+            row.latitude = record.latitude;
+            row.longitude = record.longitude;
+            row.concentration = record.concentration;
+            row.raw_concentration = record.raw_concentration;
+            row.aqi = record.aqi;
+            row.aqi_category = record.aqi_category;
+            row.timestamp = intern(record.timestamp);
+            row.pollutant = intern(record.pollutant);
+            row.unit = intern(record.unit);
+            row.site_name = intern(record.site_name);
+            row.agency = intern(record.agency);
+            row.site_id = intern(record.site_id);
+            row.full_site_id = intern(record.full_site_id);
+            rows.push_back(row);
+        }
+
+        DatasetFileHeader header{};
+        header.magic = kDatasetMagic;
+        header.layout = kDatasetLayout;
+        header.rows = rows.size();
+        header.source_bytes = source_bytes;
+        header.strings_offset = sizeof(DatasetFileHeader) + rows.size() * sizeof(DatasetRow);
+        header.strings_size = pool.size();
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(rows.data()), static_cast<std::streamsize>(rows.size() * sizeof(DatasetRow)));
+        out.write(pool.data(), static_cast<std::streamsize>(pool.size()));
+        out.close();
+        return !out.fail();
+    }
+
+    // Entries of older versions of the same CSV file
+    void removeOtherVersions(const std::string& prefix, const std::string& keep) {
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir_, ec)) {
+            std::string name = entry.path().filename().string();
+            if (name != keep && name.rfind(prefix + "-", 0) == 0 && entry.path().extension() == ".fds") {
+                std::filesystem::remove(entry.path(), ec);
+            }
+        }
+    }
+};
+
+#endif // SHARED_DATASET_HPP
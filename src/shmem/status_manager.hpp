@@ -4,83 +4,156 @@
 #include <sys/types.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
+#include <errno.h>
+#include <signal.h>
 #include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <new>
 #include <stdexcept>
+#include <string>
+#include <vector>
 #include <iostream>
 
 // Shared memory key for status coordination
 #define STATUS_SHM_KEY 2275
 
-// Status data structure - ONLY for coordination, NOT for results!
-struct ProcessStatus {
-    char process_id[8];          // A, B, C, D, E, F
-    bool is_healthy;
-    int pending_requests;
-    int active_workers;
-    int completed_requests;
-    long last_update_timestamp;  // Unix timestamp
-    double cpu_usage;            // 0.0 - 1.0
-    int queue_depth;
+constexpr size_t kCacheLineSize = 64;
+constexpr int kDefaultStatusSlots = 64;  // processes the registry holds unless the leader's config says otherwise
+constexpr size_t kMaxStatusName = 7;     // longest process id or team name
+constexpr uint32_t kStatusLayout = 4;    // bumped whenever the segment layout changes
+
+// One registered process's status - ONLY for coordination, NOT for results!
+//
+// Each slot has its own cache line, so processes updating their status never
+// contend with each other. A slot is written only by the process that
+// registered it, under a seqlock: seq is odd while a write is in progress,
+// and a reader copies the fields and retries unless seq was the same even
+// value before and after. Fields are relaxed atomics so the copy is race-free.
+struct alignas(kCacheLineSize) ProcessSlot {
+    enum State : uint32_t { kFree = 0, kClaiming = 1, kActive = 2 };
+
+    std::atomic<uint32_t> state;
+    std::atomic<uint32_t> seq;
+    std::atomic<uint64_t> id;                    // packed process id
+    std::atomic<uint64_t> team;                  // packed team name ("" for the leader)
+    std::atomic<int32_t> pending_requests;
+    std::atomic<int32_t> active_workers;
+    std::atomic<int32_t> completed_requests;
+    std::atomic<int32_t> queue_depth;            // work waiting in the process's own queues
+    std::atomic<int64_t> last_update_timestamp;  // Unix timestamp
+    std::atomic<float> cpu_usage;                // 0.0 - 1.0 of the CPUs the process may run on
+    std::atomic<int32_t> inflight_scan_kb;       // data left to read by the scans running now
+    std::atomic<int32_t> owner_pid;              // lets a full registry reclaim slots of dead processes
+    std::atomic<bool> is_healthy;
 };
-
-struct TeamStatus {
-    char team_name[16];          // "green" or "pink"
-    int total_pending_requests;
-    int total_active_workers;
-    int total_processes;
-    ProcessStatus processes[3];  // Max 3 processes per team
+static_assert(sizeof(ProcessSlot) == kCacheLineSize, "a status slot must fill exactly one cache line");
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<float>::is_always_lock_free,
+              "status slots are shared between processes and need address-free atomics");
+
+// Start of the segment. It is followed by `capacity` slots and an
+// open-addressing index of `index_size` entries mapping a process id's hash to
+// its slot, so finding a process is O(1) however many are registered.
+struct alignas(kCacheLineSize) RegistryHeader {
+    std::atomic<uint32_t> layout;                // kStatusLayout once initialized
+    uint32_t capacity;
+    uint32_t index_size;                         // power of two, at least twice the capacity
+    std::atomic<uint64_t> registry_version;      // bumped on every registration and deregistration
+    std::atomic<bool> shutdown_requested;
 };
 
-struct SystemStatus {
-    int version;                 // Increment on each update
-    bool shutdown_requested;
-    TeamStatus green_team;
-    TeamStatus pink_team;
-    long last_global_update;
+// A consistent copy of one slot
+struct ProcessSnapshot {
+    std::string process_id;
+    std::string team;
+    int slot = -1;
+    bool is_healthy = false;
+    int pending_requests = 0;
+    int active_workers = 0;
+    int completed_requests = 0;
+    int queue_depth = 0;
+    long last_update_timestamp = 0;
+    double cpu_usage = 0.0;
+    int64_t inflight_scan_bytes = 0;
+    uint32_t version = 0;        // updates written to the slot so far
 };
 
-#define STATUS_SHM_SIZE (size_t)sizeof(SystemStatus)
-
+// Registry of process status in shared memory. The leader creates it sized
+// for its configured number of processes; every process registers itself at
+// startup (taking a free slot) and deregisters at shutdown.
 class StatusManager {
 public:
-    StatusManager(bool create = false) : shmid_(-1), status_(nullptr), is_creator_(create) {
+    // Reads given up on a slot whose writer never finishes (it died mid-update)
+    static constexpr int kMaxReadAttempts = 64;
+
+    // Load score weights, in units of one busy request. CPU, outstanding scan
+    // data and queued work measure actual saturation; pending requests only
+    // bridge the gap until the next load sample, so they weigh little.
+    static constexpr double kPendingScore = 0.5;
+    static constexpr double kCpuScore = 4.0;                    // every CPU of the process busy
+    static constexpr double kScanBytesPerScore = 8.0 * (1 << 20);
+    static constexpr double kQueuedScore = 1.0;                 // a query or scan waiting its turn
+    // Load samples older than this are ignored (the process stopped sampling)
+    static constexpr long kStaleLoadSeconds = 5;
+
+    StatusManager(bool create = false, int capacity = kDefaultStatusSlots)
+        : shmid_(-1), segment_(nullptr), is_creator_(create) {
         if (create) {
+            size_t size = segmentSize(static_cast<uint32_t>(std::max(capacity, 1)));
             // Create shared memory segment
-            shmid_ = shmget(STATUS_SHM_KEY, STATUS_SHM_SIZE, IPC_CREAT | IPC_EXCL | 0666);
-            if (shmid_ < 0) {
+            shmid_ = shmget(STATUS_SHM_KEY, size, IPC_CREAT | IPC_EXCL | 0666);
+            if (shmid_ < 0 && errno == EEXIST) {
                 // Maybe it already exists, try to attach
-                shmid_ = shmget(STATUS_SHM_KEY, STATUS_SHM_SIZE, 0666);
-                if (shmid_ < 0) {
-                    throw std::runtime_error("Failed to create shared memory segment");
+                shmid_ = shmget(STATUS_SHM_KEY, size, 0666);
+                if (shmid_ < 0 && errno == EINVAL) {
+                    // Left behind with a smaller size: replace it
+                    int stale = shmget(STATUS_SHM_KEY, 0, 0666);
+                    if (stale >= 0) shmctl(stale, IPC_RMID, NULL);
+                    shmid_ = shmget(STATUS_SHM_KEY, size, IPC_CREAT | IPC_EXCL | 0666);
+                } else {
+                    is_creator_ = false;
                 }
-                is_creator_ = false;
+            }
+            if (shmid_ < 0) {
+                throw std::runtime_error("Failed to create shared memory segment");
+            }
+            attach();
+            // Initialize if creator (or if what we found was written with another layout or size)
+            if (is_creator_ || header_->layout.load(std::memory_order_acquire) != kStatusLayout ||
+                header_->capacity != static_cast<uint32_t>(std::max(capacity, 1))) {
+                initializeStatus(static_cast<uint32_t>(std::max(capacity, 1)));
             }
         } else {
-            // Attach to existing segment
-            shmid_ = shmget(STATUS_SHM_KEY, STATUS_SHM_SIZE, 0666);
+            // Attach to existing segment; its header says how big it is
+            shmid_ = shmget(STATUS_SHM_KEY, 0, 0666);
             if (shmid_ < 0) {
                 throw std::runtime_error("Failed to attach to shared memory segment. Is the leader running?");
             }
+            attach();
+            struct shmid_ds info;
+            if (header_->layout.load(std::memory_order_acquire) != kStatusLayout ||
+                shmctl(shmid_, IPC_STAT, &info) != 0 || info.shm_segsz < segmentSize(header_->capacity)) {
+                shmdt(segment_);
+                segment_ = nullptr;
+                throw std::runtime_error("Shared memory segment has another layout. Restart the leader first.");
+            }
         }
-
-        // Attach to memory
-        status_ = (SystemStatus*)shmat(shmid_, NULL, 0);
-        if (status_ == (SystemStatus*)-1) {
-            throw std::runtime_error("Failed to attach to shared memory");
-        }
-
-        // Initialize if creator
-        if (is_creator_) {
-            initializeStatus();
-        }
+        slots_ = reinterpret_cast<ProcessSlot*>(segment_ + sizeof(RegistryHeader));
+        index_ = reinterpret_cast<std::atomic<int32_t>*>(slots_ + header_->capacity);
 
         std::cout << "StatusManager: " << (is_creator_ ? "Created" : "Attached to")
-                  << " shared memory segment" << std::endl;
+                  << " shared memory segment (" << header_->capacity << " slots)" << std::endl;
     }
 
     ~StatusManager() {
-        if (status_ != nullptr && status_ != (SystemStatus*)-1) {
-            shmdt(status_);
+        deregisterProcess();
+        if (segment_ != nullptr) {
+            shmdt(segment_);
         }
 
         if (is_creator_ && shmid_ >= 0) {
@@ -89,142 +162,363 @@ public:
         }
     }
 
-    // Update status for a specific process
+    StatusManager(const StatusManager&) = delete;
+    StatusManager& operator=(const StatusManager&) = delete;
+
+    // Take a slot for this process (the one it had, if it is restarting).
+    // Returns the slot index; throws if the registry is full.
+    int registerProcess(const std::string& process_id, const std::string& team) {
+        if (process_id.empty() || process_id.size() > kMaxStatusName || team.size() > kMaxStatusName) {
+            throw std::invalid_argument("Process id and team must be 1-" + std::to_string(kMaxStatusName) +
+                                        " characters for the status registry: " + process_id);
+        }
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (own_slot_ >= 0) return own_slot_;
+
+        uint64_t id = packName(process_id);
+        int slot = lookup(id);
+        if (slot < 0 || !claim(slot, ProcessSlot::kActive)) {
+            slot = claimFree();
+            if (slot < 0) slot = claimDead();
+            if (slot < 0) {
+                throw std::runtime_error("Status registry is full (" + std::to_string(header_->capacity) +
+                                         " slots); raise status_slots in the leader's config");
+            }
+            insertIndex(id, slot);
+        }
+
+        ProcessSlot& entry = slots_[slot];
+        entry.id.store(id, std::memory_order_relaxed);
+        entry.team.store(packName(team), std::memory_order_relaxed);
+        entry.owner_pid.store(static_cast<int32_t>(getpid()), std::memory_order_relaxed);
+        own_slot_ = slot;
+        own_id_ = process_id;
+        own_ = OwnStatus{};
+        writeSlot(entry, own_);
+        entry.state.store(ProcessSlot::kActive, std::memory_order_release);
+        header_->registry_version.fetch_add(1, std::memory_order_acq_rel);
+        return slot;
+    }
+
+    // Give our slot back (also done by the destructor)
+    void deregisterProcess() {
+        if (!segment_) return;
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (own_slot_ < 0) return;
+        release(own_slot_);
+        own_slot_ = -1;
+        own_id_.clear();
+    }
+
+    // Update our own status. Ignored for other ids or before registerProcess.
     void updateProcessStatus(const std::string& process_id,
                             int pending_requests,
                             int active_workers,
-                            int completed_requests,
-                            double cpu_usage = 0.0) {
-        if (!status_) return;
-
-        status_->version++;
-        status_->last_global_update = time(nullptr);
-
-        // Find the process and update
-        TeamStatus* team = nullptr;
-        if (process_id == "A" || process_id == "B" || process_id == "C") {
-            team = &status_->green_team;
-        } else if (process_id == "D" || process_id == "E" || process_id == "F") {
-            team = &status_->pink_team;
-        } else {
-            return;
-        }
+                            int completed_requests) {
+        if (!segment_) return;
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (own_slot_ < 0 || process_id != own_id_) return;
+        own_.pending_requests = pending_requests;
+        own_.active_workers = active_workers;
+        own_.completed_requests = completed_requests;
+        writeSlot(slots_[own_slot_], own_);
+    }
 
-        // Find or create process entry
-        ProcessStatus* proc = nullptr;
-        for (int i = 0; i < 3; i++) {
-            if (strcmp(team->processes[i].process_id, process_id.c_str()) == 0) {
-                proc = &team->processes[i];
-                break;
-            }
-            if (strlen(team->processes[i].process_id) == 0) {
-                proc = &team->processes[i];
-                strncpy(proc->process_id, process_id.c_str(), 7);
-                proc->process_id[7] = '\0';
-                team->total_processes++;
-                break;
-            }
-        }
+    // Publish our latest load sample (see LoadSampler)
+    void updateLoad(const std::string& process_id, double cpu_usage, int queue_depth, int64_t inflight_scan_bytes) {
+        if (!segment_) return;
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (own_slot_ < 0 || process_id != own_id_) return;
+        own_.cpu_usage = cpu_usage;
+        own_.queue_depth = queue_depth;
+        own_.inflight_scan_bytes = inflight_scan_bytes;
+        writeSlot(slots_[own_slot_], own_);
+    }
+
+    // Consistent copy of one process's status. False if it is not registered
+    // or has not reported yet (or its slot is stuck mid-update).
+    bool readProcess(const std::string& process_id, ProcessSnapshot* out) const {
+        if (!segment_ || process_id.size() > kMaxStatusName) return false;
+        int slot = lookup(packName(process_id));
+        return slot >= 0 && readSlot(slot, out);
+    }
 
-        if (proc) {
-            proc->is_healthy = true;
-            proc->pending_requests = pending_requests;
-            proc->active_workers = active_workers;
-            proc->completed_requests = completed_requests;
-            proc->last_update_timestamp = time(nullptr);
-            proc->cpu_usage = cpu_usage;
-            proc->queue_depth = pending_requests;
+    // Every registered process that has reported, each slot read consistently
+    std::vector<ProcessSnapshot> snapshot() const {
+        std::vector<ProcessSnapshot> result;
+        if (!segment_) return result;
+        for (uint32_t slot = 0; slot < header_->capacity; ++slot) {
+            ProcessSnapshot process;
+            if (readSlot(static_cast<int>(slot), &process)) result.push_back(std::move(process));
         }
+        return result;
+    }
 
-        // Update team totals
-        updateTeamTotals(team);
+    // Changes whenever a process registers or deregisters
+    uint64_t registryVersion() const {
+        return segment_ ? header_->registry_version.load(std::memory_order_acquire) : 0;
     }
 
-    // Get load for a specific team (for load balancing decisions)
-    int getTeamLoad(const std::string& team_name) {
-        if (!status_) return 0;
+    int capacity() const { return segment_ ? static_cast<int>(header_->capacity) : 0; }
 
-        TeamStatus* team = nullptr;
-        if (team_name == "green") {
-            team = &status_->green_team;
-        } else if (team_name == "pink") {
-            team = &status_->pink_team;
-        } else {
-            return 0;
-        }
+    // How saturated a process is, in busy requests (see the k*Score weights)
+    static double loadScore(const ProcessSnapshot& process) {
+        double score = kPendingScore * process.pending_requests;
+        if (time(nullptr) - process.last_update_timestamp > kStaleLoadSeconds) return score;
+        return score + kCpuScore * process.cpu_usage +
+               static_cast<double>(process.inflight_scan_bytes) / kScanBytesPerScore +
+               kQueuedScore * process.queue_depth;
+    }
 
-        return team->total_pending_requests;
+    // Load score of every process of a team (for load balancing decisions)
+    double getTeamLoad(const std::string& team_name) const {
+        double total = 0.0;
+        for (const auto& process : snapshot()) {
+            if (process.team == team_name) total += loadScore(process);
+        }
+        return total;
     }
 
-    // Get team with lowest load (for fairness)
-    std::string getLeastLoadedTeam() {
-        if (!status_) return "green";
+    // Load score of one process (0 if it has not reported yet)
+    double getProcessLoad(const std::string& process_id) const {
+        ProcessSnapshot process;
+        return readProcess(process_id, &process) ? loadScore(process) : 0.0;
+    }
 
-        if (status_->green_team.total_pending_requests <= status_->pink_team.total_pending_requests) {
-            return "green";
-        } else {
-            return "pink";
+    // Get team with lowest load (for fairness); "" if no team has reported
+    std::string getLeastLoadedTeam() const {
+        std::map<std::string, double> load;
+        for (const auto& process : snapshot()) {
+            if (!process.team.empty()) load[process.team] += loadScore(process);
         }
+        auto best = std::min_element(load.begin(), load.end(),
+            [](const auto& a, const auto& b) { return a.second < b.second; });
+        return best == load.end() ? "" : best->first;
     }
 
     // Check if system shutdown is requested
-    bool isShutdownRequested() {
-        return status_ ? status_->shutdown_requested : false;
+    bool isShutdownRequested() const {
+        return segment_ ? header_->shutdown_requested.load(std::memory_order_acquire) : false;
     }
 
     // Request system shutdown
     void requestShutdown() {
-        if (status_) {
-            status_->shutdown_requested = true;
-            status_->version++;
+        if (segment_) {
+            header_->shutdown_requested.store(true, std::memory_order_release);
         }
     }
 
     // Print current status (for debugging)
-    void printStatus() {
-        if (!status_) return;
-
-        std::cout << "\n=== System Status (v" << status_->version << ") ===" << std::endl;
-        std::cout << "Green Team: " << status_->green_team.total_pending_requests
-                  << " pending, " << status_->green_team.total_active_workers << " active workers" << std::endl;
-        std::cout << "Pink Team: " << status_->pink_team.total_pending_requests
-                  << " pending, " << status_->pink_team.total_active_workers << " active workers" << std::endl;
+    void printStatus() const {
+        if (!segment_) return;
+
+        struct TeamTotals { int pending = 0; int active_workers = 0; double load = 0.0; };
+        std::map<std::string, TeamTotals> teams;
+        auto processes = snapshot();
+        for (const auto& process : processes) {
+            auto& team = teams[process.team.empty() ? "(none)" : process.team];
+            team.pending += process.pending_requests;
+            team.active_workers += process.active_workers;
+            team.load += loadScore(process);
+        }
+        std::cout << "\n=== System Status (registry v" << registryVersion() << ", "
+                  << processes.size() << "/" << header_->capacity << " processes) ===" << std::endl;
+        for (const auto& [team, totals] : teams) {
+            std::cout << "Team " << team << ": " << totals.pending << " pending, "
+                      << totals.active_workers << " active workers, load " << totals.load << std::endl;
+        }
         std::cout << "==============================\n" << std::endl;
     }
 
 private:
+    static constexpr int32_t kIndexEmpty = -1;
+    static constexpr int32_t kIndexRemoved = -2;
+
     int shmid_;
-    SystemStatus* status_;
+    char* segment_;
+    RegistryHeader* header_ = nullptr;
+    ProcessSlot* slots_ = nullptr;
+    std::atomic<int32_t>* index_ = nullptr;
     bool is_creator_;
+    // What we last published in our slot
+    struct OwnStatus {
+        int pending_requests = 0;
+        int active_workers = 0;
+        int completed_requests = 0;
+        double cpu_usage = 0.0;
+        int queue_depth = 0;
+        int64_t inflight_scan_bytes = 0;
+    };
+
+    std::mutex write_mutex_;  // our threads take turns writing our slot
+    int own_slot_ = -1;
+    std::string own_id_;
+    OwnStatus own_;
+
+    static size_t indexSize(uint32_t capacity) {
+        size_t size = 1;
+        while (size < 2 * static_cast<size_t>(capacity)) size <<= 1;
+        return size;
+    }
 
-    void initializeStatus() {
-        if (!status_) return;
+    static size_t segmentSize(uint32_t capacity) {
+        return sizeof(RegistryHeader) + capacity * sizeof(ProcessSlot) +
+               indexSize(capacity) * sizeof(std::atomic<int32_t>);
+    }
+
+    void attach() {
+        void* segment = shmat(shmid_, NULL, 0);
+        if (segment == (void*)-1) {
+            throw std::runtime_error("Failed to attach to shared memory");
+        }
+        segment_ = static_cast<char*>(segment);
+        header_ = reinterpret_cast<RegistryHeader*>(segment_);
+    }
 
-        memset(status_, 0, STATUS_SHM_SIZE);
-        status_->version = 0;
-        status_->shutdown_requested = false;
+    void initializeStatus(uint32_t capacity) {
+        header_->layout.store(0, std::memory_order_release);
+        new (header_) RegistryHeader();
+        header_->capacity = capacity;
+        header_->index_size = static_cast<uint32_t>(indexSize(capacity));
+        auto* slots = reinterpret_cast<ProcessSlot*>(segment_ + sizeof(RegistryHeader));
+        for (uint32_t i = 0; i < capacity; ++i) new (&slots[i]) ProcessSlot();
+        auto* index = reinterpret_cast<std::atomic<int32_t>*>(slots + capacity);
+        for (uint32_t i = 0; i < header_->index_size; ++i) new (&index[i]) std::atomic<int32_t>(kIndexEmpty);
+        header_->layout.store(kStatusLayout, std::memory_order_release);
+    }
 
-        strncpy(status_->green_team.team_name, "green", 15);
-        status_->green_team.team_name[15] = '\0';
+    // Names are at most 7 characters; packed they fit one atomic word
+    static uint64_t packName(const std::string& name) {
+        uint64_t packed = 0;
+        memcpy(&packed, name.data(), std::min(name.size(), kMaxStatusName));
+        return packed;
+    }
 
-        strncpy(status_->pink_team.team_name, "pink", 15);
-        status_->pink_team.team_name[15] = '\0';
+    static std::string unpackName(uint64_t packed) {
+        char name[kMaxStatusName + 1] = {0};
+        memcpy(name, &packed, kMaxStatusName);
+        return std::string(name);
+    }
 
-        status_->last_global_update = time(nullptr);
+    size_t homeOf(uint64_t id) const {
+        return static_cast<size_t>((id * 0x9E3779B97F4A7C15ULL) >> 32) & (header_->index_size - 1);
     }
 
-    void updateTeamTotals(TeamStatus* team) {
-        if (!team) return;
+    // Slot of a registered process, or -1
+    int lookup(uint64_t id) const {
+        size_t mask = header_->index_size - 1;
+        for (size_t probe = 0, at = homeOf(id); probe <= mask; ++probe, at = (at + 1) & mask) {
+            int32_t slot = index_[at].load(std::memory_order_acquire);
+            if (slot == kIndexEmpty) return -1;
+            if (slot == kIndexRemoved) continue;
+            if (slots_[slot].id.load(std::memory_order_acquire) == id &&
+                slots_[slot].state.load(std::memory_order_acquire) == ProcessSlot::kActive) {
+                return slot;
+            }
+        }
+        return -1;
+    }
 
-        team->total_pending_requests = 0;
-        team->total_active_workers = 0;
+    void insertIndex(uint64_t id, int32_t slot) {
+        size_t mask = header_->index_size - 1;
+        for (size_t probe = 0, at = homeOf(id); probe <= mask; ++probe, at = (at + 1) & mask) {
+            int32_t current = index_[at].load(std::memory_order_acquire);
+            while (current == kIndexEmpty || current == kIndexRemoved) {
+                if (index_[at].compare_exchange_weak(current, slot, std::memory_order_acq_rel)) return;
+            }
+        }
+    }
+
+    void removeIndex(int32_t slot) {
+        for (uint32_t at = 0; at < header_->index_size; ++at) {
+            int32_t expected = slot;
+            if (index_[at].compare_exchange_strong(expected, kIndexRemoved, std::memory_order_acq_rel)) return;
+        }
+    }
+
+    bool claim(int slot, uint32_t from) {
+        return slots_[slot].state.compare_exchange_strong(from, ProcessSlot::kClaiming, std::memory_order_acq_rel);
+    }
+
+    int claimFree() {
+        for (uint32_t slot = 0; slot < header_->capacity; ++slot) {
+            if (claim(static_cast<int>(slot), ProcessSlot::kFree)) return static_cast<int>(slot);
+        }
+        return -1;
+    }
+
+    // Full registry: take over the slot of a process that died without deregistering
+    int claimDead() {
+        for (uint32_t slot = 0; slot < header_->capacity; ++slot) {
+            pid_t owner = slots_[slot].owner_pid.load(std::memory_order_acquire);
+            if (owner <= 0 || kill(owner, 0) == 0 || errno != ESRCH) continue;
+            if (claim(static_cast<int>(slot), ProcessSlot::kActive)) {
+                removeIndex(static_cast<int32_t>(slot));
+                return static_cast<int>(slot);
+            }
+        }
+        return -1;
+    }
+
+    void release(int slot) {
+        if (!claim(slot, ProcessSlot::kActive)) return;
+        removeIndex(slot);
+        slots_[slot].id.store(0, std::memory_order_relaxed);
+        slots_[slot].owner_pid.store(0, std::memory_order_relaxed);
+        slots_[slot].state.store(ProcessSlot::kFree, std::memory_order_release);
+        header_->registry_version.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    static void writeSlot(ProcessSlot& slot, const OwnStatus& status) {
+        uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+        slot.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot.is_healthy.store(true, std::memory_order_relaxed);
+        slot.pending_requests.store(status.pending_requests, std::memory_order_relaxed);
+        slot.active_workers.store(status.active_workers, std::memory_order_relaxed);
+        slot.completed_requests.store(status.completed_requests, std::memory_order_relaxed);
+        slot.last_update_timestamp.store(time(nullptr), std::memory_order_relaxed);
+        slot.cpu_usage.store(static_cast<float>(status.cpu_usage), std::memory_order_relaxed);
+        slot.queue_depth.store(status.queue_depth, std::memory_order_relaxed);
+        slot.inflight_scan_kb.store(static_cast<int32_t>(std::min<int64_t>(status.inflight_scan_bytes >> 10, INT32_MAX)),
+                                    std::memory_order_relaxed);
+
+        slot.seq.store(seq + 2, std::memory_order_release);
+    }
 
-        for (int i = 0; i < 3; i++) {
-            if (strlen(team->processes[i].process_id) > 0) {
-                team->total_pending_requests += team->processes[i].pending_requests;
-                team->total_active_workers += team->processes[i].active_workers;
+    bool readSlot(int index, ProcessSnapshot* out) const {
+        const ProcessSlot& slot = slots_[index];
+        if (slot.state.load(std::memory_order_acquire) != ProcessSlot::kActive) return false;
+
+        for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt) {
+            uint32_t before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1) continue;  // a write is in progress
+
+            ProcessSnapshot copy;
+            uint64_t id = slot.id.load(std::memory_order_relaxed);
+            uint64_t team = slot.team.load(std::memory_order_relaxed);
+            copy.is_healthy = slot.is_healthy.load(std::memory_order_relaxed);
+            copy.pending_requests = slot.pending_requests.load(std::memory_order_relaxed);
+            copy.active_workers = slot.active_workers.load(std::memory_order_relaxed);
+            copy.completed_requests = slot.completed_requests.load(std::memory_order_relaxed);
+            copy.queue_depth = slot.queue_depth.load(std::memory_order_relaxed);
+            copy.last_update_timestamp = static_cast<long>(slot.last_update_timestamp.load(std::memory_order_relaxed));
+            copy.cpu_usage = slot.cpu_usage.load(std::memory_order_relaxed);
+            copy.inflight_scan_bytes = static_cast<int64_t>(slot.inflight_scan_kb.load(std::memory_order_relaxed)) << 10;
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (slot.seq.load(std::memory_order_relaxed) == before) {
+                if (id == 0) return false;
+                copy.process_id = unpackName(id);
+                copy.team = unpackName(team);
+                copy.slot = index;
+                copy.version = before / 2;
+                *out = std::move(copy);
+                return true;
             }
         }
+        return false;
     }
 };
 